@@ -0,0 +1,252 @@
+#include "Batch.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+
+#include "Machine.h"
+#include "Headless.h"
+#include "WorkStealingPool.h"
+#include "Farm.h"
+
+// Splits a line into words, dropping anything after a #
+static std::vector<std::string> SplitLine(const std::string& sLine)
+{
+	std::istringstream stream(sLine.substr(0, sLine.find('#')));
+	std::vector<std::string> words;
+	std::string sWord;
+	while (stream >> sWord) words.push_back(sWord);
+	return words;
+}
+
+static bool ParseNumber(const std::string& sNumber, int base, unsigned long maximum, unsigned long& number)
+{
+	char* end;
+	number = strtoul(sNumber.c_str(), &end, base);
+	return !sNumber.empty() && sNumber[0] != '-' && *end == '\0' && number <= maximum;
+}
+
+bool LoadJobs(const std::string& sFileName, std::vector<BatchJob>& jobs)
+{
+	std::ifstream input(sFileName);
+	if (!input)
+	{
+		std::cerr << "Error: unable to read " << sFileName << std::endl;
+		return false;
+	}
+
+	std::string sLine;
+	for (unsigned int nLine = 1; std::getline(input, sLine); ++nLine)
+	{
+		const std::vector<std::string> words = SplitLine(sLine);
+		if (words.empty()) continue;
+
+		auto Error = [&](const std::string& sError)
+		{
+			std::cerr << "Error: " << sFileName << " line " << nLine << ": " << sError << std::endl;
+			return false;
+		};
+
+		BatchJob job;
+		job.nLine = nLine;
+		job.sRom = words[0];
+
+		for (size_t i = 1; i < words.size(); ++i)
+		{
+			const size_t equals = words[i].find('=');
+			const std::string sKey = words[i].substr(0, equals);
+			const std::string sValue = (equals != std::string::npos) ? words[i].substr(equals + 1) : "";
+			unsigned long number;
+
+			if (sKey == "frames")
+			{
+				if (!ParseNumber(sValue, 10, UINT32_MAX, number) || number == 0) return Error("frames must be a number above 0");
+				job.nFrames = (unsigned int)number;
+			}
+			else if (sKey == "input") job.sInput = sValue;
+			else if (sKey == "screenshot") job.sScreenshot = sValue;
+			else if (sKey == "ram")
+			{
+				// Comma separated addresses, or ranges of them, in hex
+				std::istringstream ranges(sValue);
+				std::string sRange;
+				while (std::getline(ranges, sRange, ','))
+				{
+					const size_t dash = sRange.find('-');
+					unsigned long first, last;
+					if (!ParseNumber(sRange.substr(0, dash), 16, 0xFFFF, first)) return Error("bad address " + sRange);
+					if (dash == std::string::npos) last = first;
+					else if (!ParseNumber(sRange.substr(dash + 1), 16, 0xFFFF, last) || last < first) return Error("bad range " + sRange);
+					job.ram.push_back({ (uint16_t)first, (uint16_t)last });
+				}
+			}
+			else return Error("unknown setting " + words[i]);
+		}
+
+		if (job.nFrames == 0) return Error("frames= is missing");
+		jobs.push_back(job);
+	}
+
+	if (jobs.empty())
+	{
+		std::cerr << "Error: no jobs in " << sFileName << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool LoadInputScript(const std::string& sFileName, std::vector<InputEvent>& events)
+{
+	std::ifstream input(sFileName);
+	if (!input)
+	{
+		std::cerr << "Error: unable to read " << sFileName << std::endl;
+		return false;
+	}
+
+	const char* sKeyNames[8] = { "right", "left", "up", "down", "a", "b", "select", "start" };
+
+	std::string sLine;
+	for (unsigned int nLine = 1; std::getline(input, sLine); ++nLine)
+	{
+		const std::vector<std::string> words = SplitLine(sLine);
+		if (words.empty()) continue;
+
+		auto Error = [&](const std::string& sError)
+		{
+			std::cerr << "Error: " << sFileName << " line " << nLine << ": " << sError << std::endl;
+			return false;
+		};
+
+		unsigned long frame;
+		if (words.size() != 2 || !ParseNumber(words[0], 10, UINT32_MAX, frame) || frame == 0) return Error("expected FRAME KEYS");
+		if (!events.empty() && frame <= events.back().nFrame) return Error("frames must go up");
+
+		InputEvent event = { (unsigned int)frame, 0 };
+		if (words[1] != "-")
+		{
+			std::istringstream keys(words[1]);
+			std::string sKey;
+			while (std::getline(keys, sKey, '+'))
+			{
+				int key = 0;
+				while (key < 8 && sKey != sKeyNames[key]) ++key;
+				if (key == 8) return Error("unknown key " + sKey);
+				event.keys |= 1 << key;
+			}
+		}
+		events.push_back(event);
+	}
+
+	return true;
+}
+
+bool RunJob(unsigned int nJob, const BatchJob& job, const std::vector<InputEvent>* events, std::string& sResult)
+{
+	std::ostringstream result;
+	result << "job=" << nJob << " rom=" << job.sRom;
+
+	Machine machine;
+	if (!machine.Load(job.sRom))
+	{
+		result << " status=failed";
+		sResult = result.str();
+		return false;
+	}
+
+	// Only draw if there's a screenshot to take
+	machine.m_CPU.m_Memory.m_GPU.SetRenderingEnabled(!job.sScreenshot.empty());
+
+	size_t nextEvent = 0;
+	unsigned int frame = 1;
+	for (; frame <= job.nFrames && !machine.m_CPU.m_bCrashed; ++frame)
+	{
+		while (events && nextEvent < events->size() && (*events)[nextEvent].nFrame <= frame) machine.SetInput((*events)[nextEvent++].keys);
+		machine.RunFrame();
+	}
+	const bool bCrashed = machine.m_CPU.m_bCrashed;
+
+	result << " status=" << (bCrashed ? "crashed" : "ok") << " frames=" << frame - 1
+		<< " hash=" << std::hex << std::setfill('0') << std::setw(16) << machine.GetStateHash();
+
+	if (bCrashed)
+	{
+		const Fault& fault = machine.GetFault();
+		result << " fault=" << GetFaultName(fault.reason) << std::uppercase << " pc=" << std::setw(4) << fault.programCounter
+			<< " address=" << std::setw(4) << fault.address << std::nouppercase;
+	}
+
+	for (size_t i = 0; i < job.ram.size(); ++i)
+	{
+		result << (i == 0 ? " ram=" : ",") << std::uppercase << std::setw(4) << job.ram[i].first << std::nouppercase << ":";
+		for (uint32_t address = job.ram[i].first; address <= job.ram[i].second; ++address) result << std::setw(2) << (int)machine.m_CPU.m_Memory.ReadByte((uint16_t)address);
+	}
+
+	bool bSaved = true;
+	if (!job.sScreenshot.empty())
+	{
+		bSaved = SaveFrame(job.sScreenshot, machine.GetFramebuffer());
+		result << " screenshot=" << (bSaved ? job.sScreenshot : "failed");
+	}
+
+	sResult = result.str();
+	return !bCrashed && bSaved;
+}
+
+int RunBatch(const CommandLine& options)
+{
+	std::vector<BatchJob> jobs;
+	if (!LoadJobs(options.m_sBatch, jobs)) return -1;
+
+	// Scripts are read once each, before anything runs, so mistakes show up straight away
+	std::map<std::string, std::vector<InputEvent>> scripts;
+	for (const BatchJob& job : jobs)
+	{
+		if (job.sInput.empty() || scripts.count(job.sInput)) continue;
+		if (!LoadInputScript(job.sInput, scripts[job.sInput])) return -1;
+	}
+
+	std::ofstream file;
+	std::ostream* output = &std::cout;
+	if (!options.m_sOutput.empty())
+	{
+		file.open(options.m_sOutput);
+		if (!file)
+		{
+			std::cerr << "Error: unable to write " << options.m_sOutput << std::endl;
+			return -1;
+		}
+		output = &file;
+	}
+
+	if (options.m_nProcesses != 0) return RunFarm(jobs, scripts, *output, options.m_nProcesses);
+
+	WorkStealingPool pool(options.m_nThreads);
+	std::mutex outputMutex;
+	std::atomic<unsigned int> nFailed { 0 };
+
+	auto start = std::chrono::steady_clock::now();
+	pool.Run((int)jobs.size(), [&](int index)
+	{
+		const BatchJob& job = jobs[index];
+		std::string sResult;
+		if (!RunJob(index + 1, job, job.sInput.empty() ? nullptr : &scripts.at(job.sInput), sResult)) nFailed++;
+
+		// Flushed straight away, so results can be read as they come
+		std::lock_guard<std::mutex> lock(outputMutex);
+		*output << sResult << std::endl;
+	});
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cerr << jobs.size() << " jobs on " << pool.GetThreadCount() << " threads in " << std::fixed << std::setprecision(2)
+		<< seconds << "s, " << nFailed << " didn't finish" << std::endl;
+
+	return (nFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "CommandLine.h"
+
+/*
+	Runs a list of jobs - a ROM, an input script and how long to run it for -
+	across every core, writing a line of results as each one finishes. Each
+	line of the job file is a ROM followed by any of:
+		frames=N             Frames to run (required)
+		input=script.txt     Keys to press, see below
+		ram=C000-C00F,FF80   Bytes of memory to report at the end
+		screenshot=out.ppm   Save the last frame
+
+	An input script is lines of "FRAME KEYS", where the keys are some of
+	right, left, up, down, a, b, select and start joined with +, or - for
+	none. Keys are held from the start of that frame (counting from 1) until
+	the next line. Blank lines and anything after a # are ignored in both.
+
+	Results are written in the order jobs finish, one per line:
+		job=1 rom=game.gb status=ok frames=600 hash=... ram=C000:0a0b... screenshot=out.ppm
+	where the status is ok, crashed (with the frame it crashed on, and the
+	fault=, pc= and address= of what stopped it) or failed if the ROM
+	couldn't be loaded, and the hash is Machine::GetStateHash.
+	With --processes N, jobs run in worker processes instead (see Farm.h).
+*/
+
+struct InputEvent
+{
+	unsigned int nFrame;
+	uint8_t keys;
+};
+
+struct BatchJob
+{
+	unsigned int nLine;
+	std::string sRom;
+	unsigned int nFrames = 0;
+	std::string sInput;
+	std::vector<std::pair<uint16_t, uint16_t>> ram; // first and last address of each range
+	std::string sScreenshot;
+};
+
+// Each returns false, after saying what's wrong, if the file can't be used
+bool LoadJobs(const std::string& sFileName, std::vector<BatchJob>& jobs);
+bool LoadInputScript(const std::string& sFileName, std::vector<InputEvent>& events);
+
+// Runs one job, returning its line of results. Fails if it didn't finish.
+bool RunJob(unsigned int nJob, const BatchJob& job, const std::vector<InputEvent>* events, std::string& sResult);
+
+// Returns the exit code for the process
+int RunBatch(const CommandLine& options);
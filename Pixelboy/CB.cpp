@@ -6,22 +6,10 @@
 
 void CPU::CB_N(CPU* cpu, uint8_t value)
 {
-	lastValue = value;
-	auto hexToString = [](int hex) { return (static_cast<std::stringstream const&>(std::stringstream() << "0x" << std::hex << hex)).str(); };
-	
-	//std::cout << "Executing CB instruction with value " << hexToString(value) << " (" << extendedInstructions[value].sMnemonic << ")" << std::endl;
-
 	((void(*)(CPU*))extendedInstructions[value].function)(cpu);
 	cpu->ticks += extendedInstructionTicks[value];
 }
 
-void Undefined(CPU* cpu)
-{
-	auto hexToString = [](int hex) { return (static_cast<std::stringstream const&>(std::stringstream() << "0x" << std::hex << hex)).str(); };
-	std::cout << "Undefined CB instruction " << hexToString(lastValue) << "!" << std::endl;
-	cpu->m_bCrashed = true;
-}
-
 uint8_t SWAP(CPU* cpu, uint8_t value)
 {
 	// Swap upper and lower nibbles of value, reset H, N and C, 
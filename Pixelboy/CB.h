@@ -7,9 +7,6 @@ struct ExtendedOpcode
 	const void* function;
 };
 
-void Undefined(CPU* cpu);
-uint8_t lastValue;
-
 uint8_t SWAP(CPU* cpu, uint8_t value);
 void BIT(CPU* cpu, uint8_t bit, uint8_t value);
 uint8_t RL(CPU* cpu, uint8_t value);
@@ -309,7 +306,7 @@ void SRA_H(CPU* cpu);
 void SRA_L(CPU* cpu);
 void SRA_HL(CPU* cpu);
 
-const struct ExtendedOpcode extendedInstructions[256] =
+static const struct ExtendedOpcode extendedInstructions[256] =
 {
 	{ "RLC B", RLC_B },           // 0x00
 	{ "RLC C", RLC_C },           // 0x01
@@ -569,7 +566,7 @@ const struct ExtendedOpcode extendedInstructions[256] =
 	{ "SET 7, A", SET_7_A },      // 0xff
 };
 
-const unsigned char extendedInstructionTicks[256] =
+static constexpr unsigned char extendedInstructionTicks[256] =
 {
 	8, 8, 8, 8, 8,  8, 16, 8,  8, 8, 8, 8, 8, 8, 16, 8, // 0x0_
 	8, 8, 8, 8, 8,  8, 16, 8,  8, 8, 8, 8, 8, 8, 16, 8, // 0x1_
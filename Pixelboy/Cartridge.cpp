@@ -6,17 +6,9 @@
 #include <iostream>
 #include <algorithm>    // std::find
 
-// In case of error, use "tinyfiledialogs" to display an error pop-up
-#include "tinyfiledialogs.h"
-
 #define CARTRIDGE_SIZE 0x200000
 
-Cartridge::Cartridge(const std::string& sFileName)
-{
-	Reset(sFileName);
-}
-
-void Cartridge::Reset(const std::string& sFileName)
+bool Cartridge::Reset(const std::string& sFileName)
 {
 	// Load file
 	std::ifstream input(sFileName, std::ios::binary);
@@ -28,14 +20,12 @@ void Cartridge::Reset(const std::string& sFileName)
 		std::cerr << "Error: unable to load ROM " + sFileName << std::endl;
 		if (buffer.size() > CARTRIDGE_SIZE) std::cerr << "ROM too big" << std::endl;
 
-		// Make error box
-		tinyfd_messageBox("Error", std::string("Could not load file " + sFileName).c_str(), "ok", "error", 1);
-
-		exit(-1);
+		return false;
 	}
 
 	// Allocate space, zero out rest of memory and load into cartridge memory
-	m_Memory = new uint8_t[CARTRIDGE_SIZE];
+	m_Rom.reset(new uint8_t[CARTRIDGE_SIZE], std::default_delete<uint8_t[]>());
+	m_Memory = m_Rom.get();
 	for (unsigned int i = 0; i < CARTRIDGE_SIZE; ++i)	m_Memory[i] = 0;
 	for (unsigned int i = 0; i < buffer.size(); ++i)	m_Memory[i] = buffer[i];
 
@@ -51,6 +41,16 @@ void Cartridge::Reset(const std::string& sFileName)
 		case 6: m_bMBC2 = true;
 		default: break;
 	}
+
+	return true;
+}
+
+void Cartridge::Share(const Cartridge& other)
+{
+	m_Rom = other.m_Rom;
+	m_Memory = other.m_Memory;
+	m_bMBC1 = other.m_bMBC1;
+	m_bMBC2 = other.m_bMBC2;
 }
 
 std::string Cartridge::GetTitle()
@@ -75,5 +75,4 @@ std::string Cartridge::GetTitle()
 
 Cartridge::~Cartridge()
 {
-	delete[] m_Memory;
 }
\ No newline at end of file
@@ -7,16 +7,21 @@ class Cartridge
 {
 public:
 
-	Cartridge(const std::string& sFileName);
 	Cartridge() {};
 	~Cartridge();
 
-	void Reset(const std::string& sFileName);
+	// Returns false if the ROM couldn't be loaded
+	bool Reset(const std::string& sFileName);
+
+	// Uses the same ROM as another cartridge, without copying it. ROMs are
+	// never written to, so any number of machines (on any threads) can share one.
+	void Share(const Cartridge& other);
 
 	bool m_bMBC1;
 	bool m_bMBC2;
 
 	uint8_t* m_Memory = nullptr;
+	std::shared_ptr<uint8_t> m_Rom; // owns m_Memory
 
 	std::string GetTitle();
 
@@ -0,0 +1,127 @@
+#include "CommandLine.h"
+
+#include <iostream>
+#include <cstdlib>
+
+bool CommandLine::Parse(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string sArgument = argv[i];
+
+		// Options which need a value after them
+		auto HasValues = [&](int nValues)
+		{
+			if (i + nValues < argc) return true;
+			std::cerr << "Error: " << sArgument << " is missing a value" << std::endl;
+			return false;
+		};
+
+		if (sArgument == "--headless") m_bHeadless = true;
+		else if (sArgument == "--turbo") m_bTurbo = true;
+		else if (sArgument == "--bench") m_bBench = true;
+		else if (sArgument == "--stats") m_bStats = true;
+		else if (sArgument == "--accurate") m_bAccurateTiming = true;
+		else if (sArgument == "--frames" || sArgument == "--frame-skip")
+		{
+			if (!HasValues(1) || !ParseNumber(argv[++i], sArgument == "--frames" ? m_nFrames : m_nFrameSkip)) { PrintUsage(argv[0]); return false; }
+		}
+		else if (sArgument == "--render-threads")
+		{
+			if (!HasValues(1) || !ParseNumber(argv[++i], m_nRenderThreads)) { PrintUsage(argv[0]); return false; }
+		}
+		else if (sArgument == "--dump-frame")
+		{
+			if (!HasValues(2) || !ParseNumber(argv[++i], m_nDumpFrame) || m_nDumpFrame == 0) { PrintUsage(argv[0]); return false; }
+			m_sDumpFile = argv[++i];
+		}
+		else if (sArgument == "--rewind-mb")
+		{
+			if (!HasValues(1) || !ParseNumber(argv[++i], m_nRewindMegabytes)) { PrintUsage(argv[0]); return false; }
+		}
+		else if (sArgument == "--batch" || sArgument == "--output")
+		{
+			if (!HasValues(1)) { PrintUsage(argv[0]); return false; }
+			(sArgument == "--batch" ? m_sBatch : m_sOutput) = argv[++i];
+		}
+		else if (sArgument == "--threads")
+		{
+			if (!HasValues(1) || !ParseNumber(argv[++i], m_nThreads)) { PrintUsage(argv[0]); return false; }
+		}
+		else if (sArgument == "--processes")
+		{
+			if (!HasValues(1) || !ParseNumber(argv[++i], m_nProcesses)) { PrintUsage(argv[0]); return false; }
+		}
+		else if (sArgument == "--state" || sArgument == "--shm")
+		{
+			if (!HasValues(1)) { PrintUsage(argv[0]); return false; }
+			(sArgument == "--state" ? m_sState : m_sSharedFrames) = argv[++i];
+		}
+		else if (sArgument == "--hash-log" || sArgument == "--hash-check")
+		{
+			if (!HasValues(1)) { PrintUsage(argv[0]); return false; }
+			(sArgument == "--hash-log" ? m_sHashLog : m_sHashCheck) = argv[++i];
+		}
+		else if (sArgument.size() > 1 && sArgument[0] == '-')
+		{
+			std::cerr << "Error: unknown option " << sArgument << std::endl;
+			PrintUsage(argv[0]);
+			return false;
+		}
+		else if (m_sRom.empty()) m_sRom = sArgument;
+		else
+		{
+			std::cerr << "Error: more than one ROM given" << std::endl;
+			PrintUsage(argv[0]);
+			return false;
+		}
+	}
+
+	// Without a window there's nobody to pick a ROM
+	if ((m_bHeadless || m_bBench) && m_sRom.empty())
+	{
+		std::cerr << "Error: a ROM is needed to run without a window" << std::endl;
+		PrintUsage(argv[0]);
+		return false;
+	}
+
+	return true;
+}
+
+bool CommandLine::ParseNumber(const char* sNumber, unsigned int& number)
+{
+	char* end;
+	const unsigned long value = strtoul(sNumber, &end, 10);
+	if (*sNumber == '\0' || *sNumber == '-' || *end != '\0')
+	{
+		std::cerr << "Error: " << sNumber << " is not a number" << std::endl;
+		return false;
+	}
+
+	number = (unsigned int)value;
+	return true;
+}
+
+void CommandLine::PrintUsage(const char* sProgram)
+{
+	std::cerr << "Usage: " << sProgram << " [ROM] [options]" << std::endl
+		<< "       " << sProgram << " --batch jobs.txt [--output results.txt] [--threads N | --processes N]" << std::endl
+		<< "  --headless             Run without a window" << std::endl
+		<< "  --frames N             Stop after N frames" << std::endl
+		<< "  --turbo                Run as fast as possible" << std::endl
+		<< "  --dump-frame N out.ppm Save frame N as a PPM image" << std::endl
+		<< "  --state file           Load a save state before running" << std::endl
+		<< "  --bench                Time each renderer, then exit" << std::endl
+		<< "  --accurate             Time each pixel transfer by its scroll, sprites and window" << std::endl
+		<< "  --render-threads N     Draw each frame at V-Blank across N threads" << std::endl
+		<< "  --frame-skip N         Only draw every (N + 1)th frame, emulating the rest in full" << std::endl
+		<< "  --stats                Print performance stats when done (headless)" << std::endl
+		<< "  --rewind-mb N          Memory for rewinding, in megabytes (0 turns it off)" << std::endl
+		<< "  --shm NAME             Publish every frame to POSIX shared memory (see SharedFrames.h)" << std::endl
+		<< "  --hash-log file        Write the state and screen hashes of every frame (headless)" << std::endl
+		<< "  --hash-check file      Check every frame against a hash log, stopping at the first difference" << std::endl
+		<< "  --batch jobs.txt       Run every job in the file across all cores (see Batch.h)" << std::endl
+		<< "  --output results.txt   Where batch results go, rather than the console" << std::endl
+		<< "  --threads N            Threads for batch jobs, rather than one per core" << std::endl
+		<< "  --processes N          Run batch jobs in N worker processes, which survive crashes (see Farm.h)" << std::endl;
+}
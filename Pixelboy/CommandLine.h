@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "Rewind.h"
+
+/*
+	pixelboy [ROM] [--headless] [--frames N] [--turbo] [--dump-frame N out.ppm]
+	         [--state file] [--bench] [--stats] [--rewind-mb N] [--shm NAME]
+	pixelboy --batch jobs.txt [--output results.txt] [--threads N | --processes N]
+
+	With no ROM, the window asks for one. Frames are counted from 1.
+*/
+
+class CommandLine
+{
+public:
+
+	// Returns false, after printing the usage, if the arguments are bad
+	bool Parse(int argc, char* argv[]);
+
+	std::string m_sRom;
+	bool m_bHeadless = false;
+	unsigned int m_nFrames = 0; // 0 runs forever
+	bool m_bTurbo = false;
+	unsigned int m_nDumpFrame = 0; // 0 doesn't dump
+	std::string m_sDumpFile;
+	std::string m_sState;
+	bool m_bBench = false;
+	bool m_bStats = false;
+	bool m_bAccurateTiming = false; // variable length pixel transfers, see GPU::SetAccurateTiming
+	unsigned int m_nRenderThreads = 0; // 0 draws each line as it is reached
+	unsigned int m_nFrameSkip = 0; // frames skipped after each one drawn
+	unsigned int m_nRewindMegabytes = REWIND_DEFAULT_MEGABYTES; // 0 turns rewinding off
+	std::string m_sBatch;
+	std::string m_sOutput; // empty for stdout
+	unsigned int m_nThreads = 0; // 0 for one per core
+	unsigned int m_nProcesses = 0; // 0 runs batches on threads instead
+	std::string m_sSharedFrames; // shared memory to publish frames to, see SharedFrames.h
+	std::string m_sHashLog; // where to write each frame's hashes, see Headless.h
+	std::string m_sHashCheck; // a hash log to check each frame against
+
+private:
+
+	bool ParseNumber(const char* sNumber, unsigned int& number);
+	void PrintUsage(const char* sProgram);
+};
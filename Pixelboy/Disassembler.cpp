@@ -0,0 +1,98 @@
+#include "Disassembler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "CPU.h"
+
+std::vector<DisassembledLine> Disassembler::GetLines(CPU& cpu, uint16_t address, int nBefore, int nAfter)
+{
+	std::vector<DisassembledLine> lines;
+
+	// Lines before the address come from the cached bank, if it's in ROM
+	size_t next = 0;
+	const std::vector<DisassembledLine>* bank = nullptr;
+	if (address < 0x8000)
+	{
+		bank = &GetBank(cpu, address);
+		next = std::lower_bound(bank->begin(), bank->end(), address, [](const DisassembledLine& line, uint16_t address) { return line.address < address; }) - bank->begin();
+		for (size_t i = next - std::min(next, (size_t)nBefore); i < next; ++i) lines.push_back((*bank)[i]);
+	}
+
+	// Then as far as possible from the cache, falling back to disassembling
+	// as we go if the address isn't where the sweep found an instruction
+	uint16_t current = address;
+	for (int i = 0; i <= nAfter; ++i)
+	{
+		if (bank != nullptr && next < bank->size() && (*bank)[next].address == current)
+		{
+			lines.push_back((*bank)[next++]);
+			current = (next < bank->size()) ? (*bank)[next].address : current + 1;
+			continue;
+		}
+
+		int length;
+		DisassembledLine line = { current, Disassemble(cpu, current, length) };
+		lines.push_back(line);
+		current += length;
+		if (bank != nullptr) next = std::lower_bound(bank->begin(), bank->end(), current, [](const DisassembledLine& line, uint16_t address) { return line.address < address; }) - bank->begin();
+	}
+
+	return lines;
+}
+
+void Disassembler::Clear()
+{
+	m_Banks.clear();
+}
+
+std::string Disassembler::Disassemble(CPU& cpu, uint16_t address, int& length)
+{
+	const uint8_t opcode = cpu.m_Memory.ReadByte(address);
+	const CPU::Opcode& instruction = cpu.instructions[opcode];
+	length = 1 + instruction.length;
+
+	uint16_t operand = 0;
+	if (instruction.length == 1) operand = cpu.m_Memory.ReadByte(address + 1);
+	if (instruction.length == 2) operand = cpu.m_Memory.ReadShort(address + 1);
+
+	char sText[32];
+	snprintf(sText, sizeof(sText), instruction.sMnemonic, operand);
+	return sText;
+}
+
+const std::vector<DisassembledLine>& Disassembler::GetBank(CPU& cpu, uint16_t address)
+{
+	// Which bank is mapped there right now?
+	const Memory& memory = cpu.m_Memory;
+	int key;
+	uint16_t start, end;
+	if (address < 0x4000)
+	{
+		// The boot ROM covers the start of bank 0 until it's switched off
+		key = memory.m_bBootRom ? -1 : 0;
+		start = 0x0000;
+		end = 0x4000;
+	}
+	else
+	{
+		key = memory.m_bBanking ? memory.m_CurrentROMBank : 1;
+		start = 0x4000;
+		end = 0x8000;
+	}
+
+	auto cached = m_Banks.find(key);
+	if (cached != m_Banks.end()) return cached->second;
+
+	// Sweep the whole bank
+	std::vector<DisassembledLine>& lines = m_Banks[key];
+	for (unsigned int current = start; current < end;)
+	{
+		int length;
+		DisassembledLine line = { (uint16_t)current, Disassemble(cpu, (uint16_t)current, length) };
+		lines.push_back(line);
+		current += length;
+	}
+
+	return lines;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class CPU;
+
+struct DisassembledLine
+{
+	uint16_t address;
+	std::string sText;
+};
+
+/*
+	Turns code back into mnemonics for the debugger. The cartridge never
+	changes, so each ROM bank is disassembled once, from start to end, the
+	first time it's needed and kept from then on. Anywhere else (RAM, or
+	somewhere the sweep got out of step with the code) is disassembled as
+	it's asked for.
+*/
+
+class Disassembler
+{
+public:
+
+	// Up to nBefore lines before the address, then the line at the address
+	// and nAfter lines after it
+	std::vector<DisassembledLine> GetLines(CPU& cpu, uint16_t address, int nBefore, int nAfter);
+
+	// Forget every bank, for when a new cartridge is loaded
+	void Clear();
+
+	// Formats the instruction at an address, giving its length in bytes
+	static std::string Disassemble(CPU& cpu, uint16_t address, int& length);
+
+private:
+
+	const std::vector<DisassembledLine>& GetBank(CPU& cpu, uint16_t address);
+
+	// Keyed by bank number, with bank 0 whilst the boot ROM is mapped as -1
+	std::unordered_map<int, std::vector<DisassembledLine>> m_Banks;
+};
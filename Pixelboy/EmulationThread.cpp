@@ -0,0 +1,156 @@
+#include "EmulationThread.h"
+
+#include <chrono>
+#include <cstring>
+
+EmulationThread::EmulationThread(Machine& machine) : m_Machine(machine)
+{
+}
+
+EmulationThread::~EmulationThread()
+{
+	Stop();
+}
+
+void EmulationThread::Start()
+{
+	if (m_bRunning) return;
+
+	m_bRunning = true;
+	m_bFinished = false;
+	m_Thread = std::thread(&EmulationThread::Loop, this);
+}
+
+void EmulationThread::Stop()
+{
+	m_bRunning = false;
+	if (m_Thread.joinable()) m_Thread.join();
+}
+
+void EmulationThread::SetTurbo(bool bTurbo)
+{
+	m_bTurbo = bTurbo;
+}
+
+void EmulationThread::SetRewind(Rewind* rewind)
+{
+	m_Rewind = rewind;
+}
+
+void EmulationThread::SetRewinding(bool bRewinding)
+{
+	m_bRewinding = bRewinding;
+}
+
+void EmulationThread::SetFrameCallback(const std::function<bool()>& callback)
+{
+	m_FrameCallback = callback;
+}
+
+bool EmulationThread::SendInput(uint8_t keys)
+{
+	return m_Input.Push(keys);
+}
+
+bool EmulationThread::AcquireFrame()
+{
+	return m_Frames.Acquire();
+}
+
+const Frame& EmulationThread::GetFrame()
+{
+	return m_Frames.GetFront();
+}
+
+unsigned long EmulationThread::GetFramesRun()
+{
+	return m_nFramesRun;
+}
+
+bool EmulationThread::IsFinished()
+{
+	return m_bFinished;
+}
+
+int64_t EmulationThread::GetInputLatency()
+{
+	return m_InputLatency;
+}
+
+void EmulationThread::Loop()
+{
+	bool bWasTurbo = false;
+	m_Pacer.Reset();
+
+	while (m_bRunning && !m_Machine.m_CPU.m_bCrashed)
+	{
+		if (m_bRewinding && m_Rewind && m_Rewind->IsEnabled())
+		{
+			// Frames played backwards don't count as run
+			m_Rewind->StepBack(m_Machine);
+			PublishFrame();
+		}
+		else
+		{
+			ApplyInput();
+			m_Machine.RunFrame();
+			if (m_Rewind) m_Rewind->Capture(m_Machine);
+			PublishFrame();
+			m_nFramesRun++;
+
+			if (m_FrameCallback && !m_FrameCallback())
+			{
+				m_bFinished = true;
+				break;
+			}
+		}
+
+		// Don't try to catch up on the time spent in turbo
+		const bool bTurbo = m_bTurbo;
+		if (!bTurbo)
+		{
+			if (bWasTurbo) m_Pacer.Reset();
+			m_Pacer.Wait();
+		}
+		bWasTurbo = bTurbo;
+	}
+
+	m_bRunning = false;
+}
+
+void EmulationThread::ApplyInput()
+{
+	uint8_t changed = 0;
+	KeyEvent event;
+	while (m_Input.Peek(event))
+	{
+		const uint8_t difference = event.keys ^ m_Keys;
+		if (difference & changed) break;
+
+		m_Keys = event.keys;
+		changed |= difference;
+		m_Input.Pop();
+
+		m_InputLatency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - event.time;
+	}
+
+	m_Machine.SetInput(m_Keys);
+}
+
+void EmulationThread::PublishFrame()
+{
+	// Nothing to hand over if the screen hasn't changed. Every frame comes
+	// through here, so one unchanged from the last was already handed over.
+	GPU& gpu = m_Machine.m_CPU.m_Memory.m_GPU;
+	const uint64_t hash = gpu.GetFrameHash();
+	if (m_bPublished && (gpu.IsFrameUnchanged() || hash == m_PublishedHash)) return;
+
+	Frame& frame = m_Frames.GetBack();
+	memcpy(frame.screen, m_Machine.GetFramebuffer(), sizeof(frame.screen));
+	frame.hash = hash;
+	frame.number = m_nFramesRun + 1;
+	m_Frames.Publish();
+
+	m_PublishedHash = hash;
+	m_bPublished = true;
+}
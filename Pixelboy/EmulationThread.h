@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "Machine.h"
+#include "FramePacer.h"
+#include "TripleBuffer.h"
+#include "InputQueue.h"
+#include "Rewind.h"
+
+/*
+	Runs a Machine on its own thread, so presenting frames (and any stalls in
+	doing so) never hold up emulation. Finished frames come out through a
+	triple buffer, and key presses go in through a queue, so the two threads
+	never wait on each other. The Machine mustn't be touched by anything else
+	whilst the thread is running.
+*/
+
+class EmulationThread
+{
+public:
+
+	EmulationThread(Machine& machine);
+	~EmulationThread();
+
+	void Start();
+	void Stop();
+
+	// Turbo runs frames back to back, rather than at the GameBoy's rate
+	void SetTurbo(bool bTurbo);
+
+	// Snapshots are taken into the history after every frame, and whilst
+	// rewinding, each frame steps back through it instead of running
+	void SetRewind(Rewind* rewind);
+	void SetRewinding(bool bRewinding);
+
+	// Called on the emulation thread after every frame; returning false stops it
+	void SetFrameCallback(const std::function<bool()>& callback);
+
+	// Sends the whole joypad state. Events are applied at the start of a
+	// frame, and a key which changes twice waits until the next frame so
+	// quick taps are never lost. Returns false if the queue is full, in
+	// which case send the latest state again rather than dropping it.
+	bool SendInput(uint8_t keys);
+
+	// Returns true if a newer frame is available from GetFrame
+	bool AcquireFrame();
+	const Frame& GetFrame();
+
+	unsigned long GetFramesRun();
+
+	// True once the frame callback has asked to stop
+	bool IsFinished();
+
+	// Nanoseconds between the last key event being sent and it being applied
+	int64_t GetInputLatency();
+
+private:
+
+	void Loop();
+	void ApplyInput();
+	void PublishFrame();
+
+	Machine& m_Machine;
+	std::thread m_Thread;
+
+	std::atomic<bool> m_bRunning { false };
+	std::atomic<bool> m_bTurbo { false };
+	std::atomic<bool> m_bRewinding { false };
+	std::atomic<bool> m_bFinished { false };
+	std::atomic<unsigned long> m_nFramesRun { 0 };
+	std::atomic<int64_t> m_InputLatency { 0 };
+
+	TripleBuffer m_Frames;
+	InputQueue m_Input;
+	std::function<bool()> m_FrameCallback;
+	Rewind* m_Rewind = nullptr;
+
+	// Emulation thread only
+	FramePacer m_Pacer = FramePacer(FRAMES_PER_SECOND);
+	uint8_t m_Keys = 0;
+	uint64_t m_PublishedHash = 0;
+	bool m_bPublished = false;
+};
@@ -0,0 +1,182 @@
+#include "Environment.h"
+
+#include <iostream>
+
+Environment::Environment(unsigned int nMachines, unsigned int nThreads)
+{
+	m_Machines.resize(nMachines);
+	m_Start.reset(new MachineState);
+	if (nThreads > 1) m_Workers.reset(new WorkerPool(nThreads));
+
+	m_StepTask = [this](int machine) { StepMachine(machine); };
+	m_ObserveTask = [this](int machine) { ObserveMachine(machine); };
+}
+
+bool Environment::Load(const std::string& sRom, const std::string& sState)
+{
+	if (m_Machines.empty()) return false;
+
+	std::unique_ptr<Machine> machine(new Machine);
+	if (!machine->Load(sRom)) return false;
+	if (!sState.empty() && !machine->LoadState(sState)) return false;
+	machine->Snapshot(*m_Start);
+
+	// The rest are copies, sharing the ROM. The original is kept as it is,
+	// as its screen is the start's too.
+	for (std::unique_ptr<Machine>& copy : m_Machines) copy = machine->Fork();
+	m_StartMachine = std::move(machine);
+
+	return true;
+}
+
+void Environment::Reset(unsigned int nMachine)
+{
+	Machine& machine = *m_Machines[nMachine];
+	machine.Restore(*m_Start);
+	machine.m_CPU.m_Memory.m_GPU.CopyDrawing(m_StartMachine->m_CPU.m_Memory.m_GPU);
+}
+
+void Environment::Reset()
+{
+	for (unsigned int machine = 0; machine < m_Machines.size(); ++machine) Reset(machine);
+}
+
+bool Environment::SetObservation(ObservationFormat format, unsigned int nDownsample)
+{
+	if (nDownsample == 0 || 160 % nDownsample != 0 || 144 % nDownsample != 0)
+	{
+		std::cerr << "Error: the screen can't be shrunk by " << nDownsample << std::endl;
+		return false;
+	}
+
+	m_Format = format;
+	m_nDownsample = nDownsample;
+	return true;
+}
+
+unsigned int Environment::GetObservationWidth()
+{
+	return 160 / m_nDownsample;
+}
+
+unsigned int Environment::GetObservationHeight()
+{
+	return 144 / m_nDownsample;
+}
+
+unsigned int Environment::GetObservationSize()
+{
+	return GetObservationWidth() * GetObservationHeight();
+}
+
+unsigned int Environment::AddScalar(uint16_t address, unsigned int nBytes)
+{
+	// An int32_t holds up to 4
+	if (nBytes < 1) nBytes = 1;
+	if (nBytes > 4) nBytes = 4;
+
+	m_Scalars.push_back({ address, nBytes });
+	return (unsigned int)m_Scalars.size() - 1;
+}
+
+unsigned int Environment::GetScalarCount()
+{
+	return (unsigned int)m_Scalars.size();
+}
+
+void Environment::Step(const uint8_t* actions, unsigned int nFrameSkip, uint8_t* observations, int32_t* scalars, uint8_t* done)
+{
+	m_Actions = actions;
+	m_nFrameSkip = (nFrameSkip != 0) ? nFrameSkip : 1;
+	m_Observations = observations;
+	m_ScalarOutput = scalars;
+	m_Done = done;
+
+	if (m_Workers) m_Workers->Run((int)m_Machines.size(), m_StepTask);
+	else for (unsigned int machine = 0; machine < m_Machines.size(); ++machine) StepMachine(machine);
+}
+
+void Environment::Observe(uint8_t* observations, int32_t* scalars, uint8_t* done)
+{
+	m_Observations = observations;
+	m_ScalarOutput = scalars;
+	m_Done = done;
+
+	if (m_Workers) m_Workers->Run((int)m_Machines.size(), m_ObserveTask);
+	else for (unsigned int machine = 0; machine < m_Machines.size(); ++machine) ObserveMachine(machine);
+}
+
+unsigned int Environment::GetMachineCount()
+{
+	return (unsigned int)m_Machines.size();
+}
+
+Machine& Environment::GetMachine(unsigned int nMachine)
+{
+	return *m_Machines[nMachine];
+}
+
+void Environment::StepMachine(unsigned int nMachine)
+{
+	Machine& machine = *m_Machines[nMachine];
+	GPU& gpu = machine.m_CPU.m_Memory.m_GPU;
+
+	machine.SetInput(m_Actions[nMachine]);
+
+	// Only the frame which is observed needs drawing
+	for (unsigned int frame = 0; frame < m_nFrameSkip && !machine.m_CPU.m_bCrashed; ++frame)
+	{
+		gpu.SetRenderingEnabled(frame + 1 == m_nFrameSkip);
+		machine.RunFrame();
+	}
+
+	ObserveMachine(nMachine);
+}
+
+void Environment::ObserveMachine(unsigned int nMachine)
+{
+	Machine& machine = *m_Machines[nMachine];
+
+	if (m_Observations)
+	{
+		const uint8_t* screen = machine.GetFramebuffer();
+		const unsigned int width = GetObservationWidth();
+		const unsigned int height = GetObservationHeight();
+		const unsigned int n = m_nDownsample;
+		uint8_t* output = m_Observations + (size_t)nMachine * GetObservationSize();
+
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				const uint8_t* block = screen + (y * n) * 160 + x * n;
+				if (m_Format == OBSERVATION_SHADES)
+				{
+					*output++ = block[0];
+					continue;
+				}
+
+				// The colours are grays, so any channel will do
+				unsigned int total = 0;
+				for (unsigned int dy = 0; dy < n; ++dy)
+				{
+					for (unsigned int dx = 0; dx < n; ++dx) total += screenColours[block[dy * 160 + dx] & 3] & 0xFF;
+				}
+				*output++ = (uint8_t)(total / (n * n));
+			}
+		}
+	}
+
+	if (m_ScalarOutput)
+	{
+		int32_t* output = m_ScalarOutput + (size_t)nMachine * m_Scalars.size();
+		for (const Scalar& scalar : m_Scalars)
+		{
+			uint32_t value = 0;
+			for (unsigned int i = 0; i < scalar.nBytes; ++i) value |= (uint32_t)machine.m_CPU.m_Memory.ReadByte((uint16_t)(scalar.address + i)) << (8 * i);
+			*output++ = (int32_t)value;
+		}
+	}
+
+	if (m_Done) m_Done[nMachine] = machine.m_CPU.m_bCrashed ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Machine.h"
+#include "WorkerPool.h"
+
+enum ObservationFormat
+{
+	OBSERVATION_SHADES, // one byte a pixel, 0 (white) to 3 (black)
+	OBSERVATION_GRAYSCALE // one byte a pixel, 0 (black) to 255 (white)
+};
+
+/*
+	A batch of machines running the same ROM, stepped together for agents.
+	Each step holds every machine's action (a joypad state, bit n for Key n)
+	for a number of frames, then writes what each machine's screen shows and
+	some numbers read out of its memory into buffers the caller provides, one
+	machine after another. Only the last frame of a step is drawn. Nothing is
+	allocated once the environment is set up.
+
+	Observations are the screen shrunk by a whole factor (1, 2, 4, 8 or 16),
+	as either shades or grayscale. Shades take the top left pixel of each
+	block, and grayscale the average.
+*/
+
+class Environment
+{
+public:
+
+	// Machines are stepped across the given number of threads
+	Environment(unsigned int nMachines, unsigned int nThreads = 1);
+
+	// Every machine starts from power on, or the save state if one is
+	// given. Returns false if either couldn't be loaded.
+	bool Load(const std::string& sRom, const std::string& sState = "");
+
+	// Puts a machine (or all of them) back to the start
+	void Reset(unsigned int nMachine);
+	void Reset();
+
+	// Returns false if the screen can't be shrunk by that much
+	bool SetObservation(ObservationFormat format, unsigned int nDownsample);
+	unsigned int GetObservationWidth();
+	unsigned int GetObservationHeight();
+	unsigned int GetObservationSize(); // bytes for each machine
+
+	// Adds a number read from memory to each step's results, returning its
+	// index. Numbers of 2 to 4 bytes are little endian, as the CPU stores them.
+	unsigned int AddScalar(uint16_t address, unsigned int nBytes = 1);
+	unsigned int GetScalarCount();
+
+	// actions has a byte for each machine, observations room for
+	// GetObservationSize() bytes each, scalars GetScalarCount() each, and
+	// done a byte each, set if that machine has crashed. Any of the outputs
+	// can be null if they're not wanted.
+	void Step(const uint8_t* actions, unsigned int nFrameSkip, uint8_t* observations, int32_t* scalars, uint8_t* done);
+
+	// Writes the outputs without running, as after a reset
+	void Observe(uint8_t* observations, int32_t* scalars, uint8_t* done);
+
+	unsigned int GetMachineCount();
+	Machine& GetMachine(unsigned int nMachine);
+
+private:
+
+	struct Scalar
+	{
+		uint16_t address;
+		unsigned int nBytes;
+	};
+
+	void StepMachine(unsigned int nMachine);
+	void ObserveMachine(unsigned int nMachine);
+
+	std::vector<std::unique_ptr<Machine>> m_Machines;
+	std::unique_ptr<MachineState> m_Start;
+	std::unique_ptr<Machine> m_StartMachine; // for the start's screen, which isn't in its state
+	std::unique_ptr<WorkerPool> m_Workers;
+
+	ObservationFormat m_Format = OBSERVATION_SHADES;
+	unsigned int m_nDownsample = 1;
+	std::vector<Scalar> m_Scalars;
+
+	// The step being run, so the workers' task needn't capture anything
+	const uint8_t* m_Actions = nullptr;
+	unsigned int m_nFrameSkip = 1;
+	uint8_t* m_Observations = nullptr;
+	int32_t* m_ScalarOutput = nullptr;
+	uint8_t* m_Done = nullptr;
+	std::function<void(int)> m_StepTask;
+	std::function<void(int)> m_ObserveTask;
+};
@@ -0,0 +1,222 @@
+#include "Farm.h"
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#ifndef _WIN32
+
+// Results go back as a job number, whether it failed, and the line's length, then the line
+struct FarmRecord
+{
+	uint32_t job;
+	uint32_t bFailed;
+	uint32_t length;
+};
+
+// One per worker. Its ring has one writer (the worker) and one reader (the
+// supervisor), and a record only counts once the head has moved past it,
+// so a worker dying part way through writing one leaves nothing behind.
+struct FarmWorker
+{
+	std::atomic<int64_t> job; // being run, or -1
+	std::atomic<uint64_t> head; // bytes written
+	std::atomic<uint64_t> tail; // bytes read
+	uint8_t ring[FARM_RING_BYTES];
+};
+
+struct FarmShared
+{
+	std::atomic<uint32_t> nextJob;
+	FarmWorker workers[1];
+};
+
+static void CopyIn(FarmWorker& worker, uint64_t position, const void* data, size_t nBytes)
+{
+	const size_t offset = position % FARM_RING_BYTES;
+	const size_t first = std::min(nBytes, (size_t)FARM_RING_BYTES - offset);
+	memcpy(worker.ring + offset, data, first);
+	memcpy(worker.ring, (const uint8_t*)data + first, nBytes - first);
+}
+
+static void CopyOut(FarmWorker& worker, uint64_t position, void* data, size_t nBytes)
+{
+	const size_t offset = position % FARM_RING_BYTES;
+	const size_t first = std::min(nBytes, (size_t)FARM_RING_BYTES - offset);
+	memcpy(data, worker.ring + offset, first);
+	memcpy((uint8_t*)data + first, worker.ring, nBytes - first);
+}
+
+static void WriteResult(FarmWorker& worker, uint32_t job, bool bFailed, const std::string& sResult)
+{
+	FarmRecord record = { job, bFailed, (uint32_t)std::min(sResult.size(), FARM_RING_BYTES - sizeof(FarmRecord)) };
+	const uint64_t head = worker.head.load(std::memory_order_relaxed);
+	const uint64_t end = head + sizeof(FarmRecord) + record.length;
+
+	// Wait for the supervisor to make room
+	while (end - worker.tail.load(std::memory_order_acquire) > FARM_RING_BYTES) std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+	CopyIn(worker, head, &record, sizeof(record));
+	CopyIn(worker, head + sizeof(record), sResult.data(), record.length);
+	worker.head.store(end, std::memory_order_release);
+}
+
+static void RunWorker(FarmShared& shared, FarmWorker& worker, const std::vector<BatchJob>& jobs, const std::map<std::string, std::vector<InputEvent>>& scripts)
+{
+#ifdef __linux__
+	// Nobody would collect the results
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+
+	while (true)
+	{
+		const uint32_t job = shared.nextJob.fetch_add(1);
+		if (job >= jobs.size()) break;
+		worker.job.store(job);
+
+		const BatchJob& batchJob = jobs[job];
+		std::string sResult;
+		const bool bOk = RunJob(job + 1, batchJob, batchJob.sInput.empty() ? nullptr : &scripts.at(batchJob.sInput), sResult);
+		WriteResult(worker, job, !bOk, sResult);
+
+		worker.job.store(-1);
+	}
+
+	// Skips the supervisor's exit handlers and buffers, which were copied too
+	_exit(0);
+}
+
+#endif
+
+int RunFarm(const std::vector<BatchJob>& jobs, const std::map<std::string, std::vector<InputEvent>>& scripts, std::ostream& output, unsigned int nProcesses)
+{
+#ifdef _WIN32
+	std::cerr << "Error: --processes needs fork, so isn't available on Windows" << std::endl;
+	return -1;
+#else
+	// Anonymous shared memory is inherited by every worker
+	const size_t nSize = sizeof(FarmShared) + (nProcesses - 1) * sizeof(FarmWorker);
+	void* mapping = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "Error: unable to map memory for " << nProcesses << " workers" << std::endl;
+		return -1;
+	}
+	FarmShared& shared = *(FarmShared*)mapping;
+
+	std::vector<pid_t> pids(nProcesses, -1);
+	std::vector<bool> bReported(jobs.size(), false);
+	unsigned int nFailed = 0, nRestarts = 0, nRunning = 0;
+
+	auto Report = [&](uint32_t job, bool bFailed, const std::string& sResult)
+	{
+		bReported[job] = true;
+		if (bFailed) nFailed++;
+		output << sResult << std::endl;
+	};
+
+	auto Died = [&](uint32_t job, const std::string& sHow)
+	{
+		Report(job, true, "job=" + std::to_string(job + 1) + " rom=" + jobs[job].sRom + " status=died " + sHow);
+	};
+
+	auto Collect = [&](FarmWorker& worker)
+	{
+		const uint64_t head = worker.head.load(std::memory_order_acquire);
+		uint64_t tail = worker.tail.load(std::memory_order_relaxed);
+		while (tail < head)
+		{
+			FarmRecord record;
+			CopyOut(worker, tail, &record, sizeof(record));
+			std::string sResult(record.length, '\0');
+			CopyOut(worker, tail + sizeof(record), &sResult[0], record.length);
+			tail += sizeof(record) + record.length;
+			Report(record.job, record.bFailed != 0, sResult);
+		}
+		worker.tail.store(tail, std::memory_order_release);
+	};
+
+	auto Start = [&](unsigned int nWorker)
+	{
+		FarmWorker& worker = shared.workers[nWorker];
+		worker.job.store(-1);
+		worker.head.store(0);
+		worker.tail.store(0);
+
+		// Anything buffered would be written by both processes
+		output.flush();
+		std::cout.flush();
+		std::cerr.flush();
+
+		const pid_t pid = fork();
+		if (pid == 0) RunWorker(shared, worker, jobs, scripts);
+		if (pid == -1) std::cerr << "Error: unable to start a worker process" << std::endl;
+		else nRunning++;
+		pids[nWorker] = pid;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int worker = 0; worker < nProcesses; ++worker) Start(worker);
+
+	while (nRunning > 0)
+	{
+		for (unsigned int worker = 0; worker < nProcesses; ++worker) Collect(shared.workers[worker]);
+
+		int status;
+		const pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid <= 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		unsigned int nWorker = 0;
+		while (nWorker < nProcesses && pids[nWorker] != pid) ++nWorker;
+		if (nWorker == nProcesses) continue;
+		nRunning--;
+		pids[nWorker] = -1;
+
+		// Whatever it finished before it went still counts
+		FarmWorker& worker = shared.workers[nWorker];
+		Collect(worker);
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) continue;
+
+		const int64_t job = worker.job.load();
+		if (job >= 0 && !bReported[job]) Died((uint32_t)job, WIFSIGNALED(status) ? "signal=" + std::to_string(WTERMSIG(status)) : "exit=" + std::to_string(WEXITSTATUS(status)));
+
+		if (shared.nextJob.load() < jobs.size())
+		{
+			nRestarts++;
+			Start(nWorker);
+		}
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// A job taken just as its worker died, before it was noted down
+	for (size_t job = 0; job < jobs.size(); ++job)
+	{
+		if (!bReported[job]) Died((uint32_t)job, "lost");
+	}
+
+	munmap(mapping, nSize);
+
+	std::cerr << jobs.size() << " jobs on " << nProcesses << " processes in " << std::fixed << std::setprecision(2)
+		<< seconds << "s, " << nFailed << " didn't finish, " << nRestarts << " workers restarted" << std::endl;
+
+	return (nFailed == 0) ? 0 : 1;
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+
+// Room each worker has for results the supervisor hasn't collected yet
+#define FARM_RING_BYTES (1 << 20)
+
+/*
+	Batch jobs run in worker processes rather than threads (--processes N), so
+	anything which takes a process down - a bug in the emulator, or running
+	out of memory - only costs the job it was running. Workers take jobs
+	from a counter in memory shared with the supervisor, and hand back
+	results through a ring each. The supervisor writes the results as they
+	come in, and forks a new worker whenever one dies with jobs left to do.
+
+	Results are the same as RunBatch's, plus status=died (with the exit code
+	or signal) for a job whose worker didn't survive it. Only on POSIX
+	systems, as it relies on fork.
+*/
+
+// Returns the exit code for the process
+int RunFarm(const std::vector<BatchJob>& jobs, const std::map<std::string, std::vector<InputEvent>>& scripts, std::ostream& output, unsigned int nProcesses);
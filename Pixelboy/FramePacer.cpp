@@ -0,0 +1,62 @@
+#include "FramePacer.h"
+
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+// Wake up this long before the deadline, and spin the rest of the way
+#define SPIN_NANOSECONDS 1000000
+
+FramePacer::FramePacer(double fFramesPerSecond)
+{
+	m_FrameLength = (int64_t)(1000000000.0 / fFramesPerSecond);
+	Reset();
+}
+
+void FramePacer::Reset()
+{
+	m_NextFrame = GetTime() + m_FrameLength;
+}
+
+void FramePacer::Wait()
+{
+	int64_t now = GetTime();
+
+	if (now > m_NextFrame + m_FrameLength) m_NextFrame = now;
+	else if (now < m_NextFrame) SleepUntil(m_NextFrame);
+
+	m_NextFrame += m_FrameLength;
+}
+
+int64_t FramePacer::GetTime()
+{
+#ifdef _WIN32
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
+
+void FramePacer::SleepUntil(int64_t time)
+{
+	int64_t wake = time - SPIN_NANOSECONDS;
+
+	if (wake > GetTime())
+	{
+#ifdef _WIN32
+		std::this_thread::sleep_for(std::chrono::nanoseconds(wake - GetTime()));
+#else
+		timespec deadline;
+		deadline.tv_sec = wake / 1000000000;
+		deadline.tv_nsec = wake % 1000000000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) != 0) {}
+#endif
+	}
+
+	while (GetTime() < time) std::this_thread::yield();
+}
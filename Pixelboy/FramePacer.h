@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+	Keeps frames evenly spaced in real time, independent of V-Sync. Most of
+	the wait is a high resolution sleep, with the last moment spent spinning
+	as sleeps tend to overshoot by a little.
+*/
+
+class FramePacer
+{
+public:
+
+	FramePacer(double fFramesPerSecond);
+
+	// Starts timing from now
+	void Reset();
+
+	// Sleeps until the next frame is due. If we've fallen more than a frame
+	// behind, the schedule starts again from now rather than catching up.
+	void Wait();
+
+private:
+
+	int64_t GetTime();
+	void SleepUntil(int64_t time);
+
+	int64_t m_FrameLength; // nanoseconds
+	int64_t m_NextFrame;
+};
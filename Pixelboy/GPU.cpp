@@ -3,6 +3,35 @@
 #include <iostream>
 #include <sstream>
 #include <thread>
+#include <cstring>
+#include <algorithm>
+
+// White, light gray, dark gray and black
+const uint32_t screenColours[4] = { 0xFFFFFFFF, 0xFFCCCCCC, 0xFF777777, 0xFF000000 };
+
+void ConvertScreen(const uint8_t* screen, uint32_t* pixels)
+{
+	for (int i = 0; i < 160 * 144; ++i) pixels[i] = screenColours[screen[i] & 3];
+}
+
+void PackScreen(const uint8_t* screen, uint8_t* packed)
+{
+	for (int i = 0; i < SCREEN_PACKED_BYTES; ++i, screen += 4)
+	{
+		packed[i] = (screen[0] & 3) | ((screen[1] & 3) << 2) | ((screen[2] & 3) << 4) | ((screen[3] & 3) << 6);
+	}
+}
+
+void UnpackScreen(const uint8_t* packed, uint8_t* screen)
+{
+	for (int i = 0; i < SCREEN_PACKED_BYTES; ++i, screen += 4)
+	{
+		screen[0] = packed[i] & 3;
+		screen[1] = (packed[i] >> 2) & 3;
+		screen[2] = (packed[i] >> 4) & 3;
+		screen[3] = packed[i] >> 6;
+	}
+}
 
 GPU::GPU(uint8_t* vram, uint8_t* oam)
 {
@@ -23,10 +52,135 @@ void GPU::Reset(uint8_t* vram, uint8_t* oam)
 	m_LCDStatus = 0;
 	m_Coincidence = 0;
 
-	m_ScanlineCounter = 456;
+	m_Mode = MODE_HBLANK;
+	m_ModeCounter = 80;
+	m_TransferCycles = 172;
+	m_bLCDOn = false;
+	m_bAccurateTiming = false;
+	m_Renderer = RENDERER_SCANLINE;
+	m_NextRenderer = RENDERER_SCANLINE;
+	m_FIFO.StartFrame();
 
 	m_BackgroundPalette = 0;
 	m_SpritePalettes[0] = 0; m_SpritePalettes[1] = 1;
+
+	m_FrameCount = 0;
+	m_FrameSkip = 0;
+	m_bRenderingEnabled = true;
+	m_bRenderFrame = true;
+	m_bRenderedLastFrame = false;
+	m_FrameHash = 0;
+	m_bFrameUnchanged = false;
+
+	// The screen starts blank, so it hashes the same on every run
+	memset(m_ScreenData, 0, sizeof(m_ScreenData));
+	memset(m_LineHashes, 0, sizeof(m_LineHashes));
+
+	m_nCapturedLines = 0;
+	m_nVideoMemoryCopies = 0;
+	m_bVideoMemoryDirty = true;
+}
+
+void GPU::OnStateRestored()
+{
+	m_nCapturedLines = 0;
+	m_nVideoMemoryCopies = 0;
+	m_bVideoMemoryDirty = true;
+}
+
+void GPU::CopyDrawing(const GPU& other)
+{
+	memcpy(m_ScreenData, other.m_ScreenData, sizeof(m_ScreenData));
+	memcpy(m_LineHashes, other.m_LineHashes, sizeof(m_LineHashes));
+	m_FrameHash = other.m_FrameHash;
+	m_bFrameUnchanged = other.m_bFrameUnchanged;
+
+	m_FrameCount = other.m_FrameCount;
+	m_FrameSkip = other.m_FrameSkip;
+	m_bRenderingEnabled = other.m_bRenderingEnabled;
+	m_bRenderFrame = other.m_bRenderFrame;
+	m_bRenderedLastFrame = other.m_bRenderedLastFrame;
+
+	m_bAccurateTiming = other.m_bAccurateTiming;
+	m_Renderer = other.m_Renderer;
+	m_NextRenderer = other.m_NextRenderer;
+}
+
+void GPU::SetFrameSkip(unsigned int nFrameSkip)
+{
+	m_FrameSkip = nFrameSkip;
+}
+
+void GPU::SetRenderingEnabled(bool bEnabled)
+{
+	m_bRenderingEnabled = bEnabled;
+}
+
+bool GPU::DidRenderLastFrame()
+{
+	return m_bRenderedLastFrame;
+}
+
+bool GPU::IsFrameUnchanged()
+{
+	return m_bFrameUnchanged;
+}
+
+uint64_t GPU::GetFrameHash()
+{
+	return m_FrameHash;
+}
+
+void GPU::HashLine(int line)
+{
+	// FNV-1a, 8 pixels at a time
+	uint64_t hash = 14695981039346656037ull ^ line;
+	for (int x = 0; x < 160; x += 8)
+	{
+		uint64_t pixels;
+		memcpy(&pixels, &m_ScreenData[line][x], sizeof(pixels));
+		hash ^= pixels;
+		hash *= 1099511628211ull;
+	}
+	m_LineHashes[line] = hash;
+}
+
+void GPU::UpdateFrameHash()
+{
+	// A frame which wasn't drawn leaves the screen as it was
+	if (!m_bRenderFrame)
+	{
+		m_bFrameUnchanged = true;
+		return;
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	for (int line = 0; line < 144; ++line)
+	{
+		hash ^= m_LineHashes[line];
+		hash *= 1099511628211ull;
+	}
+
+	m_bFrameUnchanged = (hash == m_FrameHash) && m_FrameCount > 0;
+	m_FrameHash = hash;
+}
+
+void GPU::SetDeferredRendering(unsigned int nThreads)
+{
+	if (nThreads == 0) m_RenderWorkers.reset();
+	else m_RenderWorkers.reset(new WorkerPool(nThreads));
+
+	// Worst case is a copy of video memory for every line
+	if (m_RenderWorkers && m_VideoMemoryCopies.empty()) m_VideoMemoryCopies.resize(144);
+
+	m_nCapturedLines = 0;
+	m_nVideoMemoryCopies = 0;
+	m_bVideoMemoryDirty = true;
+}
+
+void GPU::FinishDrawing()
+{
+	if (m_RenderWorkers && m_nCapturedLines != 0) DrawCapturedFrame();
 }
 
 /*
@@ -36,112 +190,231 @@ void GPU::Reset(uint8_t* vram, uint8_t* oam)
 	http://imrannazar.com/GameBoy-Emulation-in-JavaScript:-Graphics
 */
 
+/*
+	The GPU is a state machine which only does work when a mode ends. Each
+	visible line is 456 cycles long and goes through:
+		Mode 2 - OAM scan (80 cycles)
+		Mode 3 - Pixel transfer (172 cycles, or 172 - 289 with accurate timing)
+		Mode 0 - H-Blank (the rest of the line)
+	Lines 144 - 153 are mode 1 (V-Blank), 456 cycles each. The STAT register
+	is only rewritten when the mode or LY changes, and interrupts are raised
+	as the transition happens.
+*/
+
 InterruptReturns GPU::Update(int cycles)
 {
 	InterruptReturns returnVariable;
 	returnVariable.bVblank = false;
-	returnVariable.bLCD = SetLCDStatus();
+	returnVariable.bLCD = false;
 
-	if (IsLCDEnabled()) m_ScanlineCounter -= cycles; // Move the scanline down
-	else { returnVariable.bVblank = false; return returnVariable; } // If the LCD is off, don't bother
-
-	if (m_ScanlineCounter <= 0)
+	// If the LCD is off, don't bother
+	if (!IsLCDEnabled())
 	{
-		// Move onto next scanline
-		//m_Scanline++;
-
-		m_ScanlineCounter = 456;
-
-		// V-Blank interrupt
-		if (m_Scanline == 144) returnVariable.bVblank = true;
-
-		// Reset to 0 if needed
-		else if (m_Scanline > 153) m_Scanline = 0;
+		if (m_bLCDOn) TurnLCDOff();
+		return returnVariable;
+	}
+	if (!m_bLCDOn) TurnLCDOn();
 
-		// Draw the current scanline
-		else if (m_Scanline < 144) DrawScanLine();
+	while (cycles > 0)
+	{
+		// The pixel FIFO decides for itself when the transfer is over
+		if (m_Mode == MODE_TRANSFER && m_Renderer == RENDERER_FIFO)
+		{
+			cycles -= m_FIFO.Step(*this, cycles);
+			if (m_FIFO.IsLineDone())
+			{
+				m_TransferCycles = m_FIFO.GetLineCycles();
+				if (m_bRenderFrame) HashLine(m_Scanline);
+				SetMode(MODE_HBLANK, 456 - 80 - m_TransferCycles, returnVariable);
+			}
+			continue;
+		}
 
-		m_Scanline++;
+		const int step = std::min(cycles, m_ModeCounter);
+		m_ModeCounter -= step;
+		cycles -= step;
+		if (m_ModeCounter <= 0) NextMode(returnVariable);
 	}
 
 	return returnVariable;
-	
 }
 
-bool GPU::SetLCDStatus()
+void GPU::NextMode(InterruptReturns& interrupts)
 {
-	bool bInterrupt = false;
-
-	if (!IsLCDEnabled())
+	switch (m_Mode)
 	{
-		// set the mode to 1 during lcd disabled and reset scanline
-		m_ScanlineCounter = 456;
-		m_Scanline = 0;
-		m_LCDStatus &= 252;
-		m_LCDStatus = BitSet(m_LCDStatus, 0);
-		return false;
-	}
+		case MODE_OAM:
+		{
+			m_Renderer = m_NextRenderer;
+			if (m_Renderer == RENDERER_FIFO)
+			{
+				m_FIFO.StartLine(*this, m_bRenderFrame);
+				SetMode(MODE_TRANSFER, 0, interrupts);
+				break;
+			}
 
-	uint8_t currentmode = m_LCDStatus & 0x3;
+			// The line is drawn as the pixel transfer starts
+			if (m_bRenderFrame)
+			{
+				if (m_RenderWorkers) CaptureScanLine();
+				else DrawScanLine();
+			}
 
-	uint8_t mode = 0;
-	bool reqInt = false;
+			m_TransferCycles = GetTransferCycles();
+			SetMode(MODE_TRANSFER, m_TransferCycles, interrupts);
+			break;
+		}
 
-	// in vblank so set mode to 1
-	if (m_Scanline >= 144)
-	{
-		mode = 1;
-		m_LCDStatus = BitSet(m_LCDStatus, 0);
-		m_LCDStatus = BitReset(m_LCDStatus, 1);
-		reqInt = TestBit(m_LCDStatus, 4);
-	}
-	else
-	{
-		int mode2bounds = 456 - 80;
-		int mode3bounds = mode2bounds - 172;
+		case MODE_TRANSFER:
+			SetMode(MODE_HBLANK, 456 - 80 - m_TransferCycles, interrupts);
+			break;
 
-		// mode 2
-		if (m_ScanlineCounter >= mode2bounds)
-		{
-			mode = 2;
-			m_LCDStatus = BitSet(m_LCDStatus, 1);
-			m_LCDStatus = BitReset(m_LCDStatus, 0);
-			reqInt = TestBit(m_LCDStatus, 5);
-		}
-		// mode 3
-		else if (m_ScanlineCounter >= mode3bounds)
+		case MODE_HBLANK:
 		{
-			mode = 3;
-			m_LCDStatus = BitSet(m_LCDStatus, 1);
-			m_LCDStatus = BitSet(m_LCDStatus, 0);
+			SetScanline(m_Scanline + 1, interrupts);
+
+			if (m_Scanline == 144)
+			{
+				if (m_RenderWorkers) DrawCapturedFrame();
+
+				interrupts.bVblank = true;
+				m_bRenderedLastFrame = m_bRenderFrame;
+				UpdateFrameHash();
+				m_FrameCount++;
+
+				SetMode(MODE_VBLANK, 456, interrupts);
+			}
+			else SetMode(MODE_OAM, 80, interrupts);
+			break;
 		}
-		// mode 0
-		else
+
+		case MODE_VBLANK:
 		{
-			mode = 0;
-			m_LCDStatus = BitReset(m_LCDStatus, 1);
-			m_LCDStatus = BitReset(m_LCDStatus, 0);
-			reqInt = TestBit(m_LCDStatus, 3);
+			if (m_Scanline < 153)
+			{
+				SetScanline(m_Scanline + 1, interrupts);
+				m_ModeCounter += 456;
+				break;
+			}
+
+			// Back to the top, and decide if the new frame is to be drawn
+			m_bRenderFrame = m_bRenderingEnabled && (m_FrameCount % (m_FrameSkip + 1)) == 0;
+			m_FIFO.StartFrame();
+			SetScanline(0, interrupts);
+			SetMode(MODE_OAM, 80, interrupts);
+			break;
 		}
 	}
+}
+
+void GPU::SetMode(LCDMode mode, int cycles, InterruptReturns& interrupts)
+{
+	m_Mode = mode;
+	m_ModeCounter += cycles;
+	m_LCDStatus = (m_LCDStatus & ~0b11) | mode;
+
+	// Request an interrupt if enabled for the new mode
+	switch (mode)
+	{
+		case MODE_HBLANK: if (TestBit(m_LCDStatus, 3)) interrupts.bLCD = true; break;
+		case MODE_VBLANK: if (TestBit(m_LCDStatus, 4)) interrupts.bLCD = true; break;
+		case MODE_OAM: if (TestBit(m_LCDStatus, 5)) interrupts.bLCD = true; break;
+		default: break;
+	}
+}
 
-	// just entered a new mode so request interupt
-	if (reqInt && (mode != currentmode))
-		bInterrupt = true;
+void GPU::SetScanline(uint8_t scanline, InterruptReturns& interrupts)
+{
+	m_Scanline = scanline;
+	if (CheckCoincidence()) interrupts.bLCD = true;
+}
 
-	// check the conincidence flag
+bool GPU::CheckCoincidence()
+{
 	if (m_Scanline == m_Coincidence)
 	{
 		m_LCDStatus = BitSet(m_LCDStatus, 2);
-		if (TestBit(m_LCDStatus, 6))
-			bInterrupt = true;
+		return TestBit(m_LCDStatus, 6);
 	}
-	else
+
+	m_LCDStatus = BitReset(m_LCDStatus, 2);
+	return false;
+}
+
+void GPU::WriteStatus(uint8_t data)
+{
+	// The mode and coincidence flag are read only
+	m_LCDStatus = (data & 0b01111000) | (m_LCDStatus & 0b111);
+}
+
+bool GPU::WriteCoincidence(uint8_t data)
+{
+	m_Coincidence = data;
+	return IsLCDEnabled() && CheckCoincidence();
+}
+
+void GPU::SetAccurateTiming(bool bAccurate)
+{
+	m_bAccurateTiming = bAccurate;
+}
+
+void GPU::SetRenderer(Renderer renderer)
+{
+	// Takes effect from the next line, so no line is split between the two
+	m_NextRenderer = renderer;
+}
+
+Renderer GPU::GetRenderer()
+{
+	return m_NextRenderer;
+}
+
+int GPU::GetTransferCycles()
+{
+	if (!m_bAccurateTiming) return 172;
+
+	// Discarding the fine scroll pixels stalls the transfer
+	int cycles = 172 + (m_ScrollX & 7);
+
+	// As does fetching each sprite on the line (up to 10)
+	const int ysize = (m_Control & 0b100) ? 16 : 8;
+	int nSprites = 0;
+	for (int sprite = 0; sprite < 40 && nSprites < 10; sprite++)
 	{
-		m_LCDStatus = BitReset(m_LCDStatus, 2);
+		int yPos = m_Oam[sprite * 4] - 16;
+		if (m_Scanline >= yPos && m_Scanline < yPos + ysize) nSprites++;
 	}
+	if (m_Control & 0b10) cycles += nSprites * 6;
+
+	// And starting the window
+	if ((m_Control & 0b100000) && m_WindowY <= m_Scanline && m_WindowX < 167) cycles += 6;
 
-	return bInterrupt;
+	return std::min(cycles, 289);
+}
+
+void GPU::TurnLCDOn()
+{
+	// The first line starts with the OAM scan
+	m_bLCDOn = true;
+	m_Scanline = 0;
+	m_Mode = MODE_OAM;
+	m_ModeCounter = 80;
+	m_LCDStatus = (m_LCDStatus & ~0b11) | MODE_OAM;
+	CheckCoincidence();
+	m_FIFO.StartFrame();
+}
+
+void GPU::TurnLCDOff()
+{
+	// LY is held at 0 and the mode at H-Blank whilst the LCD is off
+	m_bLCDOn = false;
+	m_Scanline = 0;
+	m_Mode = MODE_HBLANK;
+	m_ModeCounter = 80;
+	m_LCDStatus &= ~0b111;
+
+	// Lines drawn before the LCD went off stay on screen
+	FinishDrawing();
 }
 
 bool GPU::IsLCDEnabled()
@@ -166,15 +439,81 @@ bool GPU::IsLCDEnabled()
 
 void GPU::DrawScanLine()
 {
-	bool bDrawBackground = (m_Control & 0xb1);
-	if (bDrawBackground) RenderTiles();
+	RenderScanLine(GetScanlineRegisters(), m_Vram, m_Oam);
+	HashLine(m_Scanline);
+}
+
+void GPU::CaptureScanLine()
+{
+	// A ROM writing LY mid-frame sends it back to 0, so lines can come round
+	// again before V-Blank. Draw what's captured so far first, so the buffers
+	// never overflow and no row is drawn by two tasks at once.
+	if (m_nCapturedLines == 144 || (m_nCapturedLines != 0 && m_Scanline <= m_CapturedLines[m_nCapturedLines - 1].scanline))
+		DrawCapturedFrame();
+
+	// Only copy video memory if it has changed since the last line
+	if (m_bVideoMemoryDirty || m_nVideoMemoryCopies == 0)
+	{
+		VideoMemory& copy = m_VideoMemoryCopies[m_nVideoMemoryCopies++];
+		memcpy(copy.vram, m_Vram, sizeof(copy.vram));
+		memcpy(copy.oam, m_Oam, sizeof(copy.oam));
+		m_bVideoMemoryDirty = false;
+	}
 
-	bool bDrawSprites = (m_Control & 0b10);
-	if (bDrawSprites) RenderSprites();
+	ScanlineRegisters registers = GetScanlineRegisters();
+	registers.videoMemory = m_nVideoMemoryCopies - 1;
+	m_CapturedLines[m_nCapturedLines++] = registers;
 }
 
+void GPU::DrawCapturedFrame()
+{
+	// Lines write to seperate rows of the screen, so can be drawn in any order
+	const int linesPerTask = 8;
+	const int nTasks = (m_nCapturedLines + linesPerTask - 1) / linesPerTask;
 
-void GPU::RenderTiles()
+	m_RenderWorkers->Run(nTasks, [&](int task)
+	{
+		const int last = std::min(m_nCapturedLines, (task + 1) * linesPerTask);
+		for (int line = task * linesPerTask; line < last; ++line)
+		{
+			const ScanlineRegisters& registers = m_CapturedLines[line];
+			const VideoMemory& memory = m_VideoMemoryCopies[registers.videoMemory];
+			RenderScanLine(registers, memory.vram, memory.oam);
+			HashLine(registers.scanline);
+		}
+	});
+
+	// Start afresh next frame
+	m_nCapturedLines = 0;
+	m_nVideoMemoryCopies = 0;
+}
+
+ScanlineRegisters GPU::GetScanlineRegisters()
+{
+	ScanlineRegisters registers;
+	registers.scanline = m_Scanline;
+	registers.control = m_Control;
+	registers.scrollX = m_ScrollX;
+	registers.scrollY = m_ScrollY;
+	registers.windowX = m_WindowX;
+	registers.windowY = m_WindowY;
+	registers.backgroundPalette = m_BackgroundPalette;
+	registers.spritePalettes[0] = m_SpritePalettes[0];
+	registers.spritePalettes[1] = m_SpritePalettes[1];
+	registers.videoMemory = 0;
+	return registers;
+}
+
+void GPU::RenderScanLine(const ScanlineRegisters& registers, const uint8_t* vram, const uint8_t* oam)
+{
+	bool bDrawBackground = (registers.control & 0xb1);
+	if (bDrawBackground) RenderTiles(registers, vram);
+
+	bool bDrawSprites = (registers.control & 0b10);
+	if (bDrawSprites) RenderSprites(registers, vram, oam);
+}
+
+void GPU::RenderTiles(const ScanlineRegisters& registers, const uint8_t* vram)
 {
 	uint16_t tileData = 0;
 	uint16_t backgroundMemory = 0;
@@ -182,14 +521,14 @@ void GPU::RenderTiles()
 	bool bUsingWindow = false;
 
 	// Check if the window is enabled
-	if ((m_Control & 0b100000))
+	if ((registers.control & 0b100000))
 	{
 		// Is the current scanline within the window's Y pos?
-		if (m_WindowY <= m_Scanline) bUsingWindow = true;
+		if (registers.windowY <= registers.scanline) bUsingWindow = true;
 	}
 
 	// Determine which tile data we are using
-	if (TestBit(m_Control, 4)) tileData = 0x8000;
+	if (TestBit(registers.control, 4)) tileData = 0x8000;
 	else
 	{
 		// NOTE: This memory region uses signed bytes as tile identifiers!
@@ -200,20 +539,20 @@ void GPU::RenderTiles()
 	// Determine background memory
 	if (!bUsingWindow)
 	{
-		if (TestBit(m_Control, 3)) backgroundMemory = 0x9C00;
+		if (TestBit(registers.control, 3)) backgroundMemory = 0x9C00;
 		else backgroundMemory = 0x9800;
 	}
 	else
 	{
-		if (TestBit(m_Control, 6)) backgroundMemory = 0x9C00;
+		if (TestBit(registers.control, 6)) backgroundMemory = 0x9C00;
 		else backgroundMemory = 0x9800;
 	}
 
 	// The y position is used to calculate which of the 
 	// vertical 32 tiles the current scanline is drawing
 	uint8_t yPos = 0;
-	if (!bUsingWindow) yPos = m_ScrollY + m_Scanline;
-	else yPos = m_Scanline - m_WindowY;
+	if (!bUsingWindow) yPos = registers.scrollY + registers.scanline;
+	else yPos = registers.scanline - registers.windowY;
 
 	// Which pixel of the tile's 8 vertical ones is the scanline on?
 	uint16_t tileRow = (((uint8_t)(yPos / 8)) * 32);
@@ -221,10 +560,10 @@ void GPU::RenderTiles()
 	// Draw the 160 horizontal pixels for this scanline
 	for (int pixel = 0; pixel < 160; ++pixel)
 	{
-		uint8_t xPos = pixel + m_ScrollX;
+		uint8_t xPos = pixel + registers.scrollX;
 
 		// Translate to window space if nessecary
-		if (bUsingWindow && pixel >= m_WindowX) xPos = pixel - m_WindowX;
+		if (bUsingWindow && pixel >= registers.windowX) xPos = pixel - registers.windowX;
 
 		// Determine which of the 32 horizontal tiles we are drawing
 		uint16_t tileCol = (xPos / 8);
@@ -232,8 +571,8 @@ void GPU::RenderTiles()
 
 		// Get the tile identity number - signed or otherwise
 		uint16_t tileAddress = backgroundMemory + tileRow + tileCol;
-		if (bUnsigned) tileNumber = (uint8_t)m_Vram[tileAddress - 0x8000];
-		else tileNumber = (int8_t)m_Vram[tileAddress - 0x8000];
+		if (bUnsigned) tileNumber = (uint8_t)vram[tileAddress - 0x8000];
+		else tileNumber = (int8_t)vram[tileAddress - 0x8000];
 
 		// Deduce where the tile identifier is
 		uint16_t tileLocation = tileData;
@@ -244,8 +583,8 @@ void GPU::RenderTiles()
 		// Find the current vertical line
 		uint16_t line = yPos % 8;
 		line *= 2; // Each vertical line takes 2 bytes in memory
-		uint8_t data1 = m_Vram[tileLocation - 0x8000 + line ];
-		uint8_t data2 = m_Vram[tileLocation - 0x8000 + line + 1];
+		uint8_t data1 = vram[tileLocation - 0x8000 + line ];
+		uint8_t data2 = vram[tileLocation - 0x8000 + line + 1];
 
 		// Pixel 0 is bit 7, pixel 1 is bit 6, etc...
 		int colourBit = xPos % 8;
@@ -258,47 +597,34 @@ void GPU::RenderTiles()
 		colourNumber |= BitGetVal(data1, colourBit);
 
 		// Convert colour id to palette colour from 0xFF47
-		Colour colour = GetColour(colourNumber, m_BackgroundPalette);
-		int red = 0;
-		int green = 0;
-		int blue = 0;
-
-		// setup the RGB values
-		switch (colour)
-		{
-			case WHITE: red = 255; green = 255; blue = 255; break;
-			case LIGHT_GRAY:red = 0xCC; green = 0xCC; blue = 0xCC; break;
-			case DARK_GRAY: red = 0x77; green = 0x77; blue = 0x77; break;
-		}
+		Colour colour = GetColour(colourNumber, registers.backgroundPalette);
 
 		// Safety check to check we are in bounds
-		if (m_Scanline < 0 || m_Scanline > 143 || pixel < 0 || pixel > 159) continue;
+		if (registers.scanline < 0 || registers.scanline > 143 || pixel < 0 || pixel > 159) continue;
 
 		// Now we can finally write to the screen!
-		m_ScreenData[pixel][m_Scanline][0] = red;
-		m_ScreenData[pixel][m_Scanline][1] = green;
-		m_ScreenData[pixel][m_Scanline][2] = blue;
+		m_ScreenData[registers.scanline][pixel] = colour;
 	}
 }
 
-void GPU::RenderSprites()
+void GPU::RenderSprites(const ScanlineRegisters& registers, const uint8_t* vram, const uint8_t* oam)
 {
 	bool b8x16 = false;
-	if ((m_Control & 0b100)) b8x16 = true;
+	if ((registers.control & 0b100)) b8x16 = true;
 
 	for (int sprite = 0; sprite < 40; sprite++)
 	{
 		// Sprite occupies 4 bytes in the sprite attribute table
 		uint8_t index = sprite * 4;
-		uint8_t yPos = m_Oam[0xFE00 + index - 0xFE00] - 16;
-		uint8_t xPos = m_Oam[0xFE00 + index + 1 - 0xFE00] - 8;
-		uint8_t tileLocation = m_Oam[0xFE00 + index + 2 - 0xFE00];
-		uint8_t attributes = m_Oam[0xFE00 + index + 3 - 0xFE00];
+		uint8_t yPos = oam[0xFE00 + index - 0xFE00] - 16;
+		uint8_t xPos = oam[0xFE00 + index + 1 - 0xFE00] - 8;
+		uint8_t tileLocation = oam[0xFE00 + index + 2 - 0xFE00];
+		uint8_t attributes = oam[0xFE00 + index + 3 - 0xFE00];
 
 		bool yFlip = TestBit(attributes, 6);
 		bool xFlip = TestBit(attributes, 5);
 
-		int scanline = m_Scanline;
+		int scanline = registers.scanline;
 
 		int ysize = 8;
 		if (b8x16)
@@ -318,8 +644,8 @@ void GPU::RenderSprites()
 
 			line *= 2; // same as for tiles
 			uint16_t dataAddress = (0x8000 + (tileLocation * 16)) + line;
-			uint8_t data1 = m_Vram[dataAddress - 0x8000];
-			uint8_t data2 = m_Vram[dataAddress - 0x8000 + 1];
+			uint8_t data1 = vram[dataAddress - 0x8000];
+			uint8_t data2 = vram[dataAddress - 0x8000 + 1];
 
 			// its easier to read in from right to left as pixel 0 is
 			// bit 7 in the colour data, pixel 1 is bit 6 etc...
@@ -338,24 +664,13 @@ void GPU::RenderSprites()
 				colourNum <<= 1;
 				colourNum |= BitGetVal(data1, colourbit);
 
-				uint8_t palette = TestBit(attributes, 4) ? m_SpritePalettes[1] : m_SpritePalettes[0];
+				uint8_t palette = TestBit(attributes, 4) ? registers.spritePalettes[1] : registers.spritePalettes[0];
 				Colour col = GetColour(colourNum, palette);
 
 				// white is transparent for sprites.
 				if (col == WHITE)
 					continue;
 
-				int red = 0;
-				int green = 0;
-				int blue = 0;
-
-				switch (col)
-				{
-					case WHITE: red = 255;green = 255;blue = 255;break;
-					case LIGHT_GRAY:red = 0xCC;green = 0xCC;blue = 0xCC;break;
-					case DARK_GRAY:red = 0x77;green = 0x77;blue = 0x77;break;
-				}
-
 				int xPix = 0 - tilePixel;
 				xPix += 7;
 
@@ -367,14 +682,17 @@ void GPU::RenderSprites()
 					continue;
 				}
 
-				m_ScreenData[pixel][scanline][0] = red;
-				m_ScreenData[pixel][scanline][1] = green;
-				m_ScreenData[pixel][scanline][2] = blue;
+				m_ScreenData[scanline][pixel] = col;
 			}
 		}
 	}
 }
 
+void GPU::WritePixel(int x, int y, uint8_t colourNumber, uint8_t palette)
+{
+	m_ScreenData[y][x] = GetColour(colourNumber, palette);
+}
+
 Colour GPU::GetColour(uint8_t colourNumber, uint8_t palette)
 {
 	Colour res = WHITE;
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "WorkerPool.h"
+#include "PixelFIFO.h"
 
 struct InterruptReturns
 {
@@ -16,17 +21,58 @@ enum Colour
 	BLACK
 };
 
-class GPU
+// The screen holds a Colour for each pixel, and only becomes RGBA when it's
+// shown or saved. Packed, 4 pixels go in each byte, the leftmost in the low bits.
+#define SCREEN_PACKED_BYTES (160 * 144 / 4)
+
+// RGBA for each Colour, packed as 0xAABBGGRR (RGBA in memory)
+extern const uint32_t screenColours[4];
+
+void ConvertScreen(const uint8_t* screen, uint32_t* pixels);
+void PackScreen(const uint8_t* screen, uint8_t* packed);
+void UnpackScreen(const uint8_t* packed, uint8_t* screen);
+
+enum LCDMode
 {
+	MODE_HBLANK = 0,
+	MODE_VBLANK = 1,
+	MODE_OAM = 2,
+	MODE_TRANSFER = 3
+};
 
-public:
+// How the pixels of a line are produced
+enum Renderer
+{
+	RENDERER_SCANLINE,	// Fast - each line is drawn in one go as mode 3 starts
+	RENDERER_FIFO		// Accurate - dot by dot, see PixelFIFO.h
+};
 
-	GPU(uint8_t* vram, uint8_t* oam);
-	GPU() {};
-	void Reset(uint8_t* vram, uint8_t* oam);
+// Registers which affect how a scanline looks, captured when it is drawn
+struct ScanlineRegisters
+{
+	uint8_t scanline;
+	uint8_t control;
+	uint8_t scrollX;
+	uint8_t scrollY;
+	uint8_t windowX;
+	uint8_t windowY;
+	uint8_t backgroundPalette;
+	uint8_t spritePalettes[2];
+	uint16_t videoMemory; // which copy of VRAM and OAM the line reads from
+};
 
-	InterruptReturns Update(int cycles);
+// Copy of VRAM and OAM, shared by every captured line up until the next write
+struct VideoMemory
+{
+	uint8_t vram[0x2000];
+	uint8_t oam[0x100];
+};
 
+// Everything about the GPU which changes as it runs, with no pointers, so
+// it can be copied straight into and out of a save state. What's on the
+// screen and how it's drawn (frame skip, renderer, threads) aren't part of it.
+struct GPUState
+{
 	uint8_t m_Scanline;
 	uint8_t m_Control;
 	uint8_t m_ScrollX;
@@ -36,24 +82,135 @@ public:
 	uint8_t m_LCDStatus;
 	uint8_t m_Coincidence;
 
-	uint8_t* m_Vram;
-	uint8_t* m_Oam;
-
 	uint8_t m_BackgroundPalette;
 	uint8_t m_SpritePalettes[2];
 
-	uint8_t m_ScreenData[160][144][3];
+	// Current mode, and cycles left until it ends
+	LCDMode m_Mode;
+	int m_ModeCounter;
+
+	bool m_bLCDOn;
+	int m_TransferCycles;
+
+	// Part way through a line, the pixel FIFO's state matters too
+	PixelFIFO m_FIFO;
+};
+
+class GPU : public GPUState
+{
+
+public:
+
+	GPU(uint8_t* vram, uint8_t* oam);
+	GPU() {};
+	void Reset(uint8_t* vram, uint8_t* oam);
 
-	int m_ScanlineCounter;
+	InterruptReturns Update(int cycles);
+
+	uint8_t* m_Vram;
+	uint8_t* m_Oam;
+
+	// Screen data, a row at a time, with a Colour for each pixel
+	uint8_t m_ScreenData[144][160];
+
+	// Writes to STAT and LYC, which have to keep the read-only bits intact.
+	// Writing LYC returns true if it requests an LCD interrupt.
+	void WriteStatus(uint8_t data);
+	bool WriteCoincidence(uint8_t data);
+
+	// Accurate timing lengthens the pixel transfer by the fine scroll, the
+	// sprites on the line and the window, shortening H-Blank to match
+	void SetAccurateTiming(bool bAccurate);
+
+	// Picks the renderer. The pixel FIFO always has accurate timing, as the
+	// length of mode 3 falls out of it, and can't be deferred.
+	void SetRenderer(Renderer renderer);
+	Renderer GetRenderer();
+
+	// Looks a colour number up in a palette and writes it to the screen
+	void WritePixel(int x, int y, uint8_t colourNumber, uint8_t palette);
+
+	// Frame skipping: LY, STAT, timing and interrupts behave exactly the same,
+	// only pixel generation is skipped. Whether a frame produces pixels is
+	// decided as it begins (when LY wraps back to 0): it is drawn if rendering
+	// is enabled and its frame number is a multiple of (frame skip + 1). Frames
+	// are numbered by V-Blanks, starting at 0 after a reset. Skipped frames
+	// leave the screen data holding the last frame that was drawn.
+	void SetFrameSkip(unsigned int nFrameSkip);
+	void SetRenderingEnabled(bool bEnabled);
+	bool DidRenderLastFrame();
+
+	unsigned long m_FrameCount;
+
+	// Frame change detection. Each line is hashed once it has been drawn, and
+	// the line hashes are combined at V-Blank. A frame is unchanged if it was
+	// skipped or is identical to the one before, so it needn't be presented.
+	bool IsFrameUnchanged();
+	uint64_t GetFrameHash();
+
+	// Deferred rendering: rather than drawing each scanline as the emulation
+	// reaches it, capture its registers (and a copy of VRAM and OAM, but only
+	// when they have been written to since the last line) then draw the whole
+	// frame across a pool of threads at V-Blank. The screen data is complete
+	// by the time the V-Blank interrupt is returned. 0 threads draws inline.
+	void SetDeferredRendering(unsigned int nThreads);
+
+	// Draws any lines captured since the last V-Blank, for frames which end
+	// without one, so the screen data matches drawing each line inline
+	void FinishDrawing();
+
+	// Set by memory whenever VRAM or OAM is written to
+	bool m_bVideoMemoryDirty;
+
+	// After the state has been replaced, anything captured from the old one
+	// has to go. Lines already passed this frame won't be drawn until the next,
+	// so until then the screen shows what it did before (blank after a Reset).
+	void OnStateRestored();
+
+	// Takes the screen and how it's drawn (everything but the deferred
+	// rendering threads) from another GPU, so a forked machine draws the
+	// same frames as the one it came from
+	void CopyDrawing(const GPU& other);
 
 private:
 
-	bool SetLCDStatus();
+	unsigned int m_FrameSkip;
+	bool m_bRenderingEnabled;
+	bool m_bRenderFrame; // is the current frame being drawn?
+	bool m_bRenderedLastFrame;
+
+	uint64_t m_LineHashes[144];
+	uint64_t m_FrameHash;
+	bool m_bFrameUnchanged;
+
+	void NextMode(InterruptReturns& interrupts);
+	void SetMode(LCDMode mode, int cycles, InterruptReturns& interrupts);
+	void SetScanline(uint8_t scanline, InterruptReturns& interrupts);
+	bool CheckCoincidence();
+	int GetTransferCycles();
+	void TurnLCDOn();
+	void TurnLCDOff();
 	bool IsLCDEnabled();
 
+	bool m_bAccurateTiming;
+	Renderer m_Renderer;
+	Renderer m_NextRenderer;
+
 	void DrawScanLine();
-	void RenderTiles();
-	void RenderSprites();
+	void HashLine(int line);
+	void UpdateFrameHash();
+	void CaptureScanLine();
+	void DrawCapturedFrame();
+	ScanlineRegisters GetScanlineRegisters();
+	void RenderScanLine(const ScanlineRegisters& registers, const uint8_t* vram, const uint8_t* oam);
+	void RenderTiles(const ScanlineRegisters& registers, const uint8_t* vram);
+	void RenderSprites(const ScanlineRegisters& registers, const uint8_t* vram, const uint8_t* oam);
+
+	std::unique_ptr<WorkerPool> m_RenderWorkers;
+	ScanlineRegisters m_CapturedLines[144];
+	int m_nCapturedLines;
+	std::vector<VideoMemory> m_VideoMemoryCopies;
+	uint16_t m_nVideoMemoryCopies;
 
 	Colour GetColour(uint8_t colourNumber, uint8_t palette);
 
@@ -0,0 +1,91 @@
+#include "Hash.h"
+
+#include <cstring>
+
+#define PRIME_1 11400714785074694791ull
+#define PRIME_2 14029467366897019727ull
+#define PRIME_3 1609587929392839161ull
+#define PRIME_4 9650029242287828579ull
+#define PRIME_5 2870177450012600261ull
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// Reads are little endian, as every platform Pixelboy builds on is
+static inline uint64_t Read64(const uint8_t* bytes)
+{
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static inline uint32_t Read32(const uint8_t* bytes)
+{
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static inline uint64_t Round(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * PRIME_2;
+	accumulator = RotateLeft(accumulator, 31);
+	return accumulator * PRIME_1;
+}
+
+static inline uint64_t MergeRound(uint64_t hash, uint64_t accumulator)
+{
+	hash ^= Round(0, accumulator);
+	return hash * PRIME_1 + PRIME_4;
+}
+
+uint64_t HashBytes(const void* data, size_t nBytes, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	const uint8_t* end = bytes + nBytes;
+	uint64_t hash;
+
+	// Four lanes of 8 bytes at a time
+	if (nBytes >= 32)
+	{
+		uint64_t lanes[4] = { seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1 };
+		for (; bytes + 32 <= end; bytes += 32)
+		{
+			for (int lane = 0; lane < 4; ++lane) lanes[lane] = Round(lanes[lane], Read64(bytes + lane * 8));
+		}
+
+		hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+		for (int lane = 0; lane < 4; ++lane) hash = MergeRound(hash, lanes[lane]);
+	}
+	else hash = seed + PRIME_5;
+
+	hash += nBytes;
+
+	// Whatever's left over
+	for (; bytes + 8 <= end; bytes += 8)
+	{
+		hash ^= Round(0, Read64(bytes));
+		hash = RotateLeft(hash, 27) * PRIME_1 + PRIME_4;
+	}
+	if (bytes + 4 <= end)
+	{
+		hash ^= Read32(bytes) * PRIME_1;
+		hash = RotateLeft(hash, 23) * PRIME_2 + PRIME_3;
+		bytes += 4;
+	}
+	for (; bytes < end; ++bytes)
+	{
+		hash ^= *bytes * PRIME_5;
+		hash = RotateLeft(hash, 11) * PRIME_1;
+	}
+
+	// Mix the last bits in
+	hash ^= hash >> 33;
+	hash *= PRIME_2;
+	hash ^= hash >> 29;
+	hash *= PRIME_3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+	XXH64 (github.com/Cyan4973/xxHash), which gets through a whole machine
+	state in a few microseconds. A hash can be carried on into the next
+	block by passing it as the seed.
+*/
+
+uint64_t HashBytes(const void* data, size_t nBytes, uint64_t seed = 0);
@@ -0,0 +1,222 @@
+#include "Headless.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+
+#include "Machine.h"
+#include "FramePacer.h"
+#include "SharedFrames.h"
+
+// How long each renderer is benchmarked for, unless --frames says otherwise
+#define BENCH_FRAMES 3600
+
+int RunHeadless(const CommandLine& options)
+{
+	Machine machine;
+	if (!machine.Load(options.m_sRom)) return -1;
+
+	if (!options.m_sState.empty() && !machine.LoadState(options.m_sState)) return -1;
+
+	SharedFrames sharedFrames;
+	if (!options.m_sSharedFrames.empty() && !sharedFrames.Open(options.m_sSharedFrames)) return -1;
+
+	std::ofstream hashLog;
+	if (!options.m_sHashLog.empty())
+	{
+		hashLog.open(options.m_sHashLog, std::ios::binary);
+		const HashLogHeader header = { HASH_LOG_MAGIC, HASH_LOG_VERSION };
+		if (!hashLog.write((const char*)&header, sizeof(header)))
+		{
+			std::cerr << "Error: unable to write " << options.m_sHashLog << std::endl;
+			return -1;
+		}
+	}
+
+	std::ifstream hashCheck;
+	if (!options.m_sHashCheck.empty())
+	{
+		hashCheck.open(options.m_sHashCheck, std::ios::binary);
+		HashLogHeader header;
+		if (!hashCheck.read((char*)&header, sizeof(header)) || header.magic != HASH_LOG_MAGIC || header.version != HASH_LOG_VERSION)
+		{
+			std::cerr << "Error: " << options.m_sHashCheck << " isn't a hash log" << std::endl;
+			return -1;
+		}
+	}
+
+	machine.m_CPU.m_Memory.m_GPU.SetAccurateTiming(options.m_bAccurateTiming);
+	machine.m_CPU.m_Memory.m_GPU.SetDeferredRendering(options.m_nRenderThreads);
+	machine.m_CPU.m_Memory.m_GPU.SetFrameSkip(options.m_nFrameSkip);
+
+	// Nobody sees the screen, so only draw it if a frame is to be saved, published or hashed
+	machine.m_CPU.m_Memory.m_GPU.SetRenderingEnabled(options.m_nDumpFrame != 0 || sharedFrames.IsOpen()
+		|| hashLog.is_open() || hashCheck.is_open());
+
+	FramePacer pacer(FRAMES_PER_SECOND);
+	unsigned int nChecked = 0;
+	for (unsigned int frame = 1; options.m_nFrames == 0 || frame <= options.m_nFrames; ++frame)
+	{
+		machine.RunFrame();
+
+		// Hashed before anything else, so a crash is checked like any other frame
+		if (hashLog.is_open() || hashCheck.is_open())
+		{
+			const HashLogRecord record = { machine.GetStateHash(), machine.GetScreenHash() };
+			hashLog.write((const char*)&record, sizeof(record));
+
+			HashLogRecord expected;
+			if (hashCheck.is_open() && !hashCheck.read((char*)&expected, sizeof(expected))) break;
+			if (hashCheck.is_open() && (record.state != expected.state || record.screen != expected.screen))
+			{
+				std::cerr << "Error: frame " << frame << " differs from " << options.m_sHashCheck << std::hex << std::endl;
+				if (record.state != expected.state) std::cerr << "  state hash " << record.state << ", expected " << expected.state << std::endl;
+				if (record.screen != expected.screen) std::cerr << "  screen hash " << record.screen << ", expected " << expected.screen << std::endl;
+				return 1;
+			}
+			nChecked++;
+		}
+
+		if (machine.m_CPU.m_bCrashed)
+		{
+			const Fault& fault = machine.GetFault();
+			std::cerr << "Error: crashed during frame " << frame << " (" << GetFaultName(fault.reason) << " at PC 0x" << std::hex
+				<< fault.programCounter << ", address 0x" << fault.address << ")" << std::endl;
+			return 1;
+		}
+
+		if (frame == options.m_nDumpFrame && !SaveFrame(options.m_sDumpFile, machine.GetFramebuffer())) return -1;
+		sharedFrames.Publish(machine);
+
+		if (!options.m_bTurbo) pacer.Wait();
+	}
+
+	if (hashLog.is_open() && !hashLog.flush())
+	{
+		std::cerr << "Error: unable to write " << options.m_sHashLog << std::endl;
+		return -1;
+	}
+
+	// Stopping before the end of the log (with --frames) isn't a pass
+	if (hashCheck.is_open())
+	{
+		const std::streamoff position = hashCheck.tellg();
+		const std::streamoff size = hashCheck.seekg(0, std::ios::end).tellg();
+		if (position != -1 && size > position)
+		{
+			std::cerr << "Error: stopped after " << nChecked << " frames, with " << (size - position) / sizeof(HashLogRecord)
+				<< " frames of " << options.m_sHashCheck << " left unchecked" << std::endl;
+			return 1;
+		}
+		std::cout << "All " << nChecked << " frames in " << options.m_sHashCheck << " match" << std::endl;
+	}
+
+	if (options.m_bStats) PrintStats(machine.m_Profiler.GetStats());
+
+	return 0;
+}
+
+int RunBenchmark(const CommandLine& options)
+{
+	Machine machine;
+	if (!machine.Load(options.m_sRom)) return -1;
+
+	const unsigned int nFrames = (options.m_nFrames != 0) ? options.m_nFrames : BENCH_FRAMES;
+
+	struct Benchmark
+	{
+		const char* sName;
+		Renderer renderer;
+		bool bAccurateTiming;
+		unsigned int nRenderThreads;
+	};
+
+	// Deferred rendering gets every core unless --render-threads says otherwise
+	const unsigned int nRenderThreads = (options.m_nRenderThreads != 0) ? options.m_nRenderThreads : std::max(1u, std::thread::hardware_concurrency());
+	const Benchmark benchmarks[4] =
+	{
+		{ "scanline", RENDERER_SCANLINE, false, 0 },
+		{ "accurate", RENDERER_SCANLINE, true, 0 },
+		{ "deferred", RENDERER_SCANLINE, false, nRenderThreads },
+		{ "fifo", RENDERER_FIFO, true, 0 }
+	};
+
+	std::cout << std::fixed << std::setprecision(2);
+	double scanlineSeconds = 0.0;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		// Every renderer starts from power on
+		machine.Reset();
+		machine.m_CPU.m_Memory.m_GPU.SetRenderer(benchmark.renderer);
+		machine.m_CPU.m_Memory.m_GPU.SetAccurateTiming(benchmark.bAccurateTiming);
+		machine.m_CPU.m_Memory.m_GPU.SetDeferredRendering(benchmark.nRenderThreads);
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int frame = 0; frame < nFrames && !machine.m_CPU.m_bCrashed; ++frame) machine.RunFrame();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << std::left << std::setw(10) << benchmark.sName << nFrames << " frames in " << seconds * 1000.0 << "ms, "
+			<< nFrames / seconds << " fps (" << nFrames / seconds / FRAMES_PER_SECOND << "x)";
+
+		// Everything else is compared against the first
+		if (scanlineSeconds == 0.0) scanlineSeconds = seconds;
+		else std::cout << ", " << scanlineSeconds / seconds << "x scanline";
+		if (benchmark.nRenderThreads != 0) std::cout << " with " << benchmark.nRenderThreads << (benchmark.nRenderThreads == 1 ? " thread" : " threads");
+		std::cout << std::endl;
+
+		if (options.m_bStats) PrintStats(machine.m_Profiler.GetStats());
+	}
+
+	return 0;
+}
+
+void PrintStats(const ProfileStats& stats)
+{
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Last " << stats.nFrames << " frames:" << std::endl
+		<< "  frame time  p50 " << stats.frameMilliseconds50 << "ms, p99 " << stats.frameMilliseconds99 << "ms" << std::endl
+#ifdef PIXELBOY_PROFILE
+		<< "  cpu         " << stats.sectionMilliseconds[PROFILE_CPU] << "ms" << std::endl
+		<< "  gpu         " << stats.sectionMilliseconds[PROFILE_GPU] << "ms" << std::endl
+		<< "  interrupts  " << stats.sectionMilliseconds[PROFILE_INTERRUPTS] << "ms" << std::endl
+#else
+		<< "  (build with PIXELBOY_PROFILE for the time in each part)" << std::endl
+#endif
+		<< "  speed       " << stats.instructionsPerSecond / 1000000.0 << " MIPS, "
+		<< stats.framesPerSecond / FRAMES_PER_SECOND << "x" << std::endl;
+
+	// Histogram of frame times, as bars of up to 40 characters
+	unsigned int tallest = 1;
+	for (unsigned int count : stats.histogram) tallest = std::max(tallest, count);
+	for (int bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS; ++bucket)
+	{
+		if (stats.histogram[bucket] == 0) continue;
+		std::cout << "  " << std::setw(8) << bucket * stats.histogramMilliseconds << "ms "
+			<< std::string(1 + stats.histogram[bucket] * 39 / tallest, '#') << " " << stats.histogram[bucket] << std::endl;
+	}
+}
+
+bool SaveFrame(const std::string& sFileName, const uint8_t* framebuffer)
+{
+	std::ofstream output(sFileName, std::ios::binary);
+	if (!output)
+	{
+		std::cerr << "Error: unable to write " << sFileName << std::endl;
+		return false;
+	}
+
+	output << "P6\n160 144\n255\n";
+
+	// Colours are 0xAABBGGRR
+	for (int i = 0; i < 160 * 144; ++i)
+	{
+		const uint32_t colour = screenColours[framebuffer[i] & 3];
+		const char rgb[3] = { (char)(colour & 0xFF), (char)((colour >> 8) & 0xFF), (char)((colour >> 16) & 0xFF) };
+		output.write(rgb, 3);
+	}
+
+	return (bool)output;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#include "CommandLine.h"
+#include "Profiler.h"
+
+/*
+	Running without a window, for automation and batch jobs. None of this
+	touches X11 or OpenGL, so it starts (and runs) as fast as the core can.
+
+	--hash-log writes Machine::GetStateHash and GetScreenHash after every
+	frame, so two builds can be run from the same ROM and input and checked
+	against each other with --hash-check, which stops at the first frame
+	that differs (and fails if --frames stops it before the log ends). Only
+	compare builds with the same save state version, as the state hash
+	covers everything a save state does.
+*/
+
+#define HASH_LOG_MAGIC 0x4C484250 // "PBHL"
+#define HASH_LOG_VERSION 1
+
+// A hash log is this header, then a record for each frame from frame 1
+struct HashLogHeader
+{
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct HashLogRecord
+{
+	uint64_t state;
+	uint64_t screen;
+};
+
+// Each returns the exit code for the process
+int RunHeadless(const CommandLine& options);
+int RunBenchmark(const CommandLine& options);
+
+// Prints where the time went over the last few frames
+void PrintStats(const ProfileStats& stats);
+
+// Saves the screen as a binary PPM
+bool SaveFrame(const std::string& sFileName, const uint8_t* framebuffer);
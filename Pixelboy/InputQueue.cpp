@@ -0,0 +1,30 @@
+#include "InputQueue.h"
+
+#include <chrono>
+
+bool InputQueue::Push(uint8_t keys)
+{
+	const unsigned int tail = m_Tail.load(std::memory_order_relaxed);
+	if (tail - m_Head.load(std::memory_order_acquire) == INPUT_QUEUE_SIZE) return false;
+
+	KeyEvent& event = m_Events[tail & (INPUT_QUEUE_SIZE - 1)];
+	event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	event.keys = keys;
+
+	m_Tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputQueue::Peek(KeyEvent& event)
+{
+	const unsigned int head = m_Head.load(std::memory_order_relaxed);
+	if (head == m_Tail.load(std::memory_order_acquire)) return false;
+
+	event = m_Events[head & (INPUT_QUEUE_SIZE - 1)];
+	return true;
+}
+
+void InputQueue::Pop()
+{
+	m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
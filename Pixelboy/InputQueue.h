@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// The whole joypad (bit n is Key n) as of a moment in time
+struct KeyEvent
+{
+	int64_t time; // steady clock, nanoseconds
+	uint8_t keys;
+};
+
+#define INPUT_QUEUE_SIZE 64 // must be a power of 2
+
+/*
+	Lock-free queue of key events from one producer thread to one consumer
+	thread, as a ring buffer where each side only writes its own index.
+*/
+
+class InputQueue
+{
+public:
+
+	// Producer: returns false if the queue is full
+	bool Push(uint8_t keys);
+
+	// Consumer: looks at the oldest event without removing it
+	bool Peek(KeyEvent& event);
+	void Pop();
+
+private:
+
+	KeyEvent m_Events[INPUT_QUEUE_SIZE];
+
+	std::atomic<unsigned int> m_Head { 0 }; // next to read
+	std::atomic<unsigned int> m_Tail { 0 }; // next to write
+};
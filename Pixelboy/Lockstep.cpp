@@ -0,0 +1,166 @@
+#include "Lockstep.h"
+
+#include <cstring>
+#include <utility>
+
+Lockstep::Lockstep(unsigned int nLanes)
+{
+	m_LaneGroups.assign(nLanes, 0);
+	m_LaneInputs.assign(nLanes, 0);
+	m_State.reset(new MachineState);
+}
+
+bool Lockstep::Load(const std::string& sFileName)
+{
+	std::unique_ptr<Machine> machine(new Machine);
+	if (!machine->Load(sFileName)) return false;
+	machine->m_CPU.m_Memory.m_GPU.SetRenderingEnabled(m_bRendering);
+
+	m_Groups.clear();
+	m_Spare.clear();
+	m_Groups.push_back(std::move(machine));
+
+	Reset();
+	return true;
+}
+
+void Lockstep::Reset()
+{
+	// Everyone back in the first group
+	while (m_Groups.size() > 1)
+	{
+		m_Spare.push_back(std::move(m_Groups.back()));
+		m_Groups.pop_back();
+	}
+	if (!m_Groups.empty()) m_Groups[0]->Reset();
+
+	m_LaneGroups.assign(m_LaneGroups.size(), 0);
+	m_LaneInputs.assign(m_LaneInputs.size(), 0);
+}
+
+void Lockstep::SetRenderingEnabled(bool bEnabled)
+{
+	m_bRendering = bEnabled;
+	for (std::unique_ptr<Machine>& machine : m_Groups) machine->m_CPU.m_Memory.m_GPU.SetRenderingEnabled(bEnabled);
+	for (std::unique_ptr<Machine>& machine : m_Spare) machine->m_CPU.m_Memory.m_GPU.SetRenderingEnabled(bEnabled);
+}
+
+void Lockstep::SetInput(unsigned int nLane, uint8_t keys)
+{
+	m_LaneInputs[nLane] = keys;
+}
+
+void Lockstep::RunFrame()
+{
+	if (m_Groups.empty()) return;
+
+	Split();
+
+	// Every lane in a group has the same input now
+	std::vector<bool> bInputSet(m_Groups.size(), false);
+	for (size_t lane = 0; lane < m_LaneGroups.size(); ++lane)
+	{
+		const unsigned int group = m_LaneGroups[lane];
+		if (bInputSet[group]) continue;
+		m_Groups[group]->SetInput(m_LaneInputs[lane]);
+		bInputSet[group] = true;
+	}
+
+	for (std::unique_ptr<Machine>& machine : m_Groups) machine->RunFrame();
+
+	if (m_Groups.size() > 1) Merge();
+}
+
+Machine& Lockstep::GetMachine(unsigned int nLane)
+{
+	return *m_Groups[m_LaneGroups[nLane]];
+}
+
+unsigned int Lockstep::GetLaneCount()
+{
+	return (unsigned int)m_LaneGroups.size();
+}
+
+unsigned int Lockstep::GetGroupCount()
+{
+	return (unsigned int)m_Groups.size();
+}
+
+void Lockstep::Split()
+{
+	// The first input seen in a group keeps its machine, and lanes with a
+	// different one move to a copy of it
+	struct Branch
+	{
+		unsigned int group;
+		uint8_t keys;
+		unsigned int newGroup;
+	};
+	std::vector<Branch> branches;
+	std::vector<int> groupKeys(m_Groups.size(), -1);
+
+	for (size_t lane = 0; lane < m_LaneGroups.size(); ++lane)
+	{
+		const unsigned int group = m_LaneGroups[lane];
+		const uint8_t keys = m_LaneInputs[lane];
+
+		if (groupKeys[group] == -1) groupKeys[group] = keys;
+		if (groupKeys[group] == keys) continue;
+
+		size_t branch = 0;
+		while (branch < branches.size() && (branches[branch].group != group || branches[branch].keys != keys)) ++branch;
+		if (branch == branches.size())
+		{
+			std::unique_ptr<Machine> copy = Clone(*m_Groups[group]);
+			m_Groups.push_back(std::move(copy));
+			branches.push_back({ group, keys, (unsigned int)m_Groups.size() - 1 });
+		}
+		m_LaneGroups[lane] = branches[branch].newGroup;
+	}
+}
+
+void Lockstep::Merge()
+{
+	// Groups which have ended up in the same state become one again
+	std::vector<std::unique_ptr<Machine>> groups;
+	std::vector<unsigned int> newGroups(m_Groups.size());
+
+	for (size_t group = 0; group < m_Groups.size(); ++group)
+	{
+		size_t same = 0;
+		while (same < groups.size() && !IsSameState(*groups[same], *m_Groups[group])) ++same;
+
+		newGroups[group] = (unsigned int)same;
+		if (same < groups.size()) m_Spare.push_back(std::move(m_Groups[group]));
+		else groups.push_back(std::move(m_Groups[group]));
+	}
+
+	m_Groups = std::move(groups);
+	for (unsigned int& group : m_LaneGroups) group = newGroups[group];
+}
+
+std::unique_ptr<Machine> Lockstep::Clone(Machine& machine)
+{
+	if (m_Spare.empty()) return machine.Fork();
+
+	// Reusing a machine saves making a new one
+	std::unique_ptr<Machine> copy = std::move(m_Spare.back());
+	m_Spare.pop_back();
+
+	machine.Snapshot(*m_State);
+	copy->Restore(*m_State);
+	copy->m_CPU.m_Memory.m_GPU.CopyDrawing(machine.m_CPU.m_Memory.m_GPU);
+
+	return copy;
+}
+
+bool Lockstep::IsSameState(Machine& a, Machine& b)
+{
+	// The CPU is the quickest to compare, and almost always differs if anything does
+	if (memcmp(static_cast<CPUState*>(&a.m_CPU), static_cast<CPUState*>(&b.m_CPU), sizeof(CPUState)) != 0) return false;
+	if (memcmp(static_cast<GPUState*>(&a.m_CPU.m_Memory.m_GPU), static_cast<GPUState*>(&b.m_CPU.m_Memory.m_GPU), sizeof(GPUState)) != 0) return false;
+	if (memcmp(static_cast<MemoryState*>(&a.m_CPU.m_Memory), static_cast<MemoryState*>(&b.m_CPU.m_Memory), sizeof(MemoryState)) != 0) return false;
+
+	// Lanes which took different routes to the same state may have drawn different frames
+	return !m_bRendering || memcmp(a.GetFramebuffer(), b.GetFramebuffer(), sizeof(a.m_CPU.m_Memory.m_GPU.m_ScreenData)) == 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Machine.h"
+
+/*
+	Many copies ("lanes") of one ROM, stepped a frame at a time, each with
+	its own input. The emulator is deterministic, so lanes in the same state
+	given the same input stay in the same state - those are run once, by a
+	single Machine shared between them. A lane splits off (with a copy of the
+	state) when its input differs from the rest of its group, and groups
+	whose states come back together merge again. Lots of copies of a game
+	sitting in the same menu, or all pressing the same buttons, cost little
+	more than one.
+
+	Experimental, and not a SIMD core: each group is an ordinary Machine, so
+	lanes that never agree cost a Machine each, as usual, and there's no gain
+	once every lane has different input. On the test ROM, 64 lanes managed
+	about 103,000 lane-frames a second with the same input (1 group), but only
+	16,600 with 8 different inputs (8 groups), against 3,200 frames a second
+	for a single Machine.
+*/
+
+class Lockstep
+{
+public:
+
+	Lockstep(unsigned int nLanes);
+
+	// Every lane starts from power on. Returns false if the ROM couldn't be loaded.
+	bool Load(const std::string& sFileName);
+	void Reset();
+
+	// Drawing is off by default, as it's often not needed
+	void SetRenderingEnabled(bool bEnabled);
+
+	// Bit n is set if Key n is held, from the next frame on
+	void SetInput(unsigned int nLane, uint8_t keys);
+
+	// Runs every lane until its next V-Blank
+	void RunFrame();
+
+	// The machine a lane is in. It may be shared with other lanes, so it
+	// mustn't be changed.
+	Machine& GetMachine(unsigned int nLane);
+
+	unsigned int GetLaneCount();
+
+	// How many machines are actually running
+	unsigned int GetGroupCount();
+
+private:
+
+	void Split();
+	void Merge();
+	std::unique_ptr<Machine> Clone(Machine& machine);
+	bool IsSameState(Machine& a, Machine& b);
+
+	bool m_bRendering = false;
+
+	// Each group is a running machine, and each lane is in a group
+	std::vector<std::unique_ptr<Machine>> m_Groups;
+	std::vector<std::unique_ptr<Machine>> m_Spare;
+	std::vector<unsigned int> m_LaneGroups;
+	std::vector<uint8_t> m_LaneInputs;
+
+	std::unique_ptr<MachineState> m_State;
+};
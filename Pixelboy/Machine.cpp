@@ -0,0 +1,283 @@
+#include "Machine.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Reset zeroes it with memset, and snapshots copy it with memcpy
+static_assert(std::is_trivial<MachineState>::value, "Machine state must be plain data");
+
+Machine::Machine()
+{
+	m_nLastTicks = 0;
+	m_Input = 0;
+	m_bVblank = false;
+	m_RomHash = 0;
+}
+
+bool Machine::Load(const std::string& sFileName)
+{
+	if (!m_CPU.m_Memory.m_Cartridge.Reset(sFileName)) return false;
+
+	// The header (title, licensee, checksums...) tells ROMs apart for save states
+	m_RomHash = 2166136261u;
+	for (uint16_t address = 0x134; address < 0x150; ++address) m_RomHash = (m_RomHash ^ m_CPU.m_Memory.m_Cartridge.m_Memory[address]) * 16777619u;
+
+	Reset();
+	return true;
+}
+
+void Machine::Reset()
+{
+	// Everything starts from zero, padding and unused parts included, so
+	// machines in the same state hash the same
+	memset(static_cast<CPUState*>(&m_CPU), 0, sizeof(CPUState));
+	memset(static_cast<MemoryState*>(&m_CPU.m_Memory), 0, sizeof(MemoryState));
+	memset(static_cast<GPUState*>(&m_CPU.m_Memory.m_GPU), 0, sizeof(GPUState));
+
+	m_CPU.m_Memory.Reset(false);
+	m_CPU.m_Memory.m_GPU.Reset(m_CPU.m_Memory.m_Vram, m_CPU.m_Memory.m_Oam);
+	m_CPU.Reset();
+
+	// All buttons start released
+	for (int i = 0; i < 8; ++i) m_CPU.KeyReleased(i);
+	m_Input = 0;
+
+	m_nLastTicks = 0;
+	m_bVblank = false;
+}
+
+unsigned int Machine::RunFrame()
+{
+	unsigned int cycles = 0;
+	m_bVblank = false;
+
+	m_Profiler.StartFrame();
+	while (!m_bVblank && cycles < CYCLES_PER_FRAME && !m_CPU.m_bCrashed) cycles += Step();
+	if (!m_bVblank) m_CPU.m_Memory.m_GPU.FinishDrawing();
+	m_Profiler.EndFrame();
+
+	return cycles;
+}
+
+unsigned int Machine::RunCycles(unsigned int nCycles)
+{
+	unsigned int cycles = 0;
+	while (cycles < nCycles && !m_CPU.m_bCrashed) cycles += Step();
+
+	return cycles;
+}
+
+unsigned int Machine::Step()
+{
+	const bool bTimed = m_Profiler.CountInstruction();
+
+	// Update CPU
+	unsigned int ticks;
+	{
+		PROFILE_SCOPE(m_Profiler, PROFILE_CPU, bTimed);
+		ticks = m_CPU.Update();
+	}
+	if (m_CPU.m_bCrashed) return 0;
+	unsigned int cycles = ticks - m_nLastTicks;
+
+	// Update timers
+	{
+		PROFILE_SCOPE(m_Profiler, PROFILE_INTERRUPTS, bTimed);
+		m_CPU.UpdateTimers(cycles);
+	}
+
+	// Update GPU
+	if (!m_CPU.m_bStopped)
+	{
+		InterruptReturns interrupts;
+		{
+			PROFILE_SCOPE(m_Profiler, PROFILE_GPU, bTimed);
+			interrupts = m_CPU.m_Memory.m_GPU.Update(cycles);
+		}
+		if (interrupts.bVblank) { m_CPU.RequestInterrupt(VBLANK_FLAG_BIT); m_bVblank = true; }
+		if (interrupts.bLCD) m_CPU.RequestInterrupt(LCD_FLAG_BIT);
+	}
+
+	// Do interrupts and keep track of timing
+	{
+		PROFILE_SCOPE(m_Profiler, PROFILE_INTERRUPTS, bTimed);
+		m_CPU.CheckForInterrupts();
+	}
+	m_nLastTicks = ticks;
+
+	return cycles;
+}
+
+const uint8_t* Machine::GetFramebuffer()
+{
+	return &m_CPU.m_Memory.m_GPU.m_ScreenData[0][0];
+}
+
+void Machine::SetInput(uint8_t keys)
+{
+	// Only tell the CPU about buttons which have changed
+	uint8_t changed = keys ^ m_Input;
+	for (int key = 0; key < 8; ++key)
+	{
+		if (!(changed & (1 << key))) continue;
+
+		if (keys & (1 << key)) m_CPU.KeyPressed(key);
+		else m_CPU.KeyReleased(key);
+	}
+
+	m_Input = keys;
+}
+
+uint8_t Machine::GetInput()
+{
+	return m_Input;
+}
+
+const Fault& Machine::GetFault()
+{
+	return m_CPU.m_Memory.m_Fault;
+}
+
+void Machine::Snapshot(MachineState& state)
+{
+	state.magic = STATE_MAGIC;
+	state.version = STATE_VERSION;
+	state.size = sizeof(MachineState);
+	state.romHash = m_RomHash;
+
+	memcpy(&state.cpu, static_cast<CPUState*>(&m_CPU), sizeof(CPUState));
+	memcpy(&state.memory, static_cast<MemoryState*>(&m_CPU.m_Memory), sizeof(MemoryState));
+	memcpy(&state.gpu, static_cast<GPUState*>(&m_CPU.m_Memory.m_GPU), sizeof(GPUState));
+}
+
+bool Machine::Restore(const MachineState& state)
+{
+	if (state.magic != STATE_MAGIC || state.version != STATE_VERSION || state.size != sizeof(MachineState))
+	{
+		std::cerr << "Error: save state is from a different version" << std::endl;
+		return false;
+	}
+
+	if (state.romHash != m_RomHash)
+	{
+		std::cerr << "Error: save state is for a different ROM" << std::endl;
+		return false;
+	}
+
+	// Banks are used as offsets straight away, so a damaged state mustn't reach outside the memory.
+	// Nor may LY, which picks the screen row to draw: only V-Blank is past the last line.
+	const GPUState& gpu = state.gpu;
+	const bool bGPUValid = (unsigned int)gpu.m_Mode <= MODE_TRANSFER && gpu.m_Scanline <= 153
+		&& (gpu.m_Scanline < 144 || gpu.m_Mode == MODE_VBLANK) && gpu.m_FIFO.IsValid();
+	if (state.memory.m_CurrentROMBank >= 0x80 || state.memory.m_CurrentRAMBank >= 4 || !bGPUValid)
+	{
+		std::cerr << "Error: save state is damaged" << std::endl;
+		return false;
+	}
+
+	memcpy(static_cast<CPUState*>(&m_CPU), &state.cpu, sizeof(CPUState));
+	memcpy(static_cast<MemoryState*>(&m_CPU.m_Memory), &state.memory, sizeof(MemoryState));
+	memcpy(static_cast<GPUState*>(&m_CPU.m_Memory.m_GPU), &state.gpu, sizeof(GPUState));
+	m_CPU.m_Memory.m_GPU.OnStateRestored();
+
+	// Pick up where the snapshot left off
+	m_nLastTicks = m_CPU.ticks;
+	m_Input = ~m_CPU.m_Memory.m_JoypadState;
+	m_bVblank = false;
+
+	return true;
+}
+
+std::unique_ptr<Machine> Machine::Fork()
+{
+	std::unique_ptr<Machine> child(new Machine);
+	child->m_CPU.m_Memory.m_Cartridge.Share(m_CPU.m_Memory.m_Cartridge);
+	child->m_RomHash = m_RomHash;
+
+	// Points the child's GPU at its own VRAM and OAM
+	child->Reset();
+
+	memcpy(static_cast<CPUState*>(&child->m_CPU), static_cast<CPUState*>(&m_CPU), sizeof(CPUState));
+	memcpy(static_cast<MemoryState*>(&child->m_CPU.m_Memory), static_cast<MemoryState*>(&m_CPU.m_Memory), sizeof(MemoryState));
+	memcpy(static_cast<GPUState*>(&child->m_CPU.m_Memory.m_GPU), static_cast<GPUState*>(&m_CPU.m_Memory.m_GPU), sizeof(GPUState));
+	child->m_CPU.m_Memory.m_GPU.OnStateRestored();
+	child->m_CPU.m_Memory.m_GPU.CopyDrawing(m_CPU.m_Memory.m_GPU);
+
+	child->m_nLastTicks = m_nLastTicks;
+	child->m_Input = m_Input;
+	child->m_bVblank = m_bVblank;
+
+	return child;
+}
+
+uint64_t Machine::GetStateHash()
+{
+	// The same bytes a snapshot copies, hashed where they are
+	uint64_t hash = HashBytes(&m_RomHash, sizeof(m_RomHash));
+	hash = HashBytes(static_cast<CPUState*>(&m_CPU), sizeof(CPUState), hash);
+	hash = HashBytes(static_cast<MemoryState*>(&m_CPU.m_Memory), sizeof(MemoryState), hash);
+	return HashBytes(static_cast<GPUState*>(&m_CPU.m_Memory.m_GPU), sizeof(GPUState), hash);
+}
+
+uint64_t Machine::GetScreenHash()
+{
+	return HashBytes(m_CPU.m_Memory.m_GPU.m_ScreenData, sizeof(m_CPU.m_Memory.m_GPU.m_ScreenData));
+}
+
+bool Machine::SaveState(const std::string& sFileName)
+{
+	MachineState* state = new MachineState;
+	Snapshot(*state);
+
+	std::ofstream output(sFileName, std::ios::binary);
+	output.write((const char*)state, sizeof(MachineState));
+	delete state;
+
+	if (!output)
+	{
+		std::cerr << "Error: unable to write save state " << sFileName << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Machine::LoadState(const std::string& sFileName)
+{
+#ifdef _WIN32
+	MachineState* state = new MachineState;
+	std::ifstream input(sFileName, std::ios::binary);
+	input.read((char*)state, sizeof(MachineState));
+	const bool bRead = input.gcount() == sizeof(MachineState);
+	const bool bRestored = bRead && Restore(*state);
+	delete state;
+#else
+	// Mapping the file saves copying it into a buffer first
+	bool bRead = false, bRestored = false;
+	const int file = open(sFileName.c_str(), O_RDONLY);
+	struct stat status;
+	if (file != -1 && fstat(file, &status) == 0 && status.st_size == sizeof(MachineState))
+	{
+		void* mapping = mmap(nullptr, sizeof(MachineState), PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping != MAP_FAILED)
+		{
+			bRead = true;
+			bRestored = Restore(*(const MachineState*)mapping);
+			munmap(mapping, sizeof(MachineState));
+		}
+	}
+	if (file != -1) close(file);
+#endif
+
+	if (!bRead) std::cerr << "Error: unable to read save state " << sFileName << std::endl;
+	return bRestored;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "CPU.h"
+#include "Profiler.h"
+
+// A frame lasts 154 lines of 456 cycles, so there are ~59.73 a second
+#define CYCLES_PER_FRAME 70224
+#define FRAMES_PER_SECOND ((double)MAX_CLOCKS_PER_SECOND / CYCLES_PER_FRAME)
+
+// Buttons, as bits of the joypad state
+enum Key
+{
+	KEY_RIGHT,
+	KEY_LEFT,
+	KEY_UP,
+	KEY_DOWN,
+	KEY_A,
+	KEY_B,
+	KEY_SELECT,
+	KEY_START
+};
+
+#define STATE_MAGIC 0x54534250 // "PBST"
+#define STATE_VERSION 2
+
+/*
+	Everything needed to put a Machine back exactly as it was, as one block
+	with no pointers. Snapshots are a memcpy of each part, and save states
+	are this block as it is in memory, so only load on the same build (the
+	size is checked, as are the version and the ROM).
+*/
+struct MachineState
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t romHash;
+
+	CPUState cpu;
+	MemoryState memory;
+	GPUState gpu;
+};
+
+/*
+	A whole GameBoy - the CPU, memory, GPU and cartridge - stepped together.
+	This is all the emulator needs to run, and doesn't depend on a window,
+	so frontends (or anything headless) just drive a Machine.
+*/
+
+class Machine
+{
+public:
+
+	Machine();
+
+	// Returns false if the ROM couldn't be loaded
+	bool Load(const std::string& sFileName);
+	void Reset();
+
+	// Runs until the next V-Blank, or a frame's worth of cycles if the LCD
+	// is off. With the LCD on, V-Blanks are exactly CYCLES_PER_FRAME apart.
+	// Returns the cycles run.
+	unsigned int RunFrame();
+
+	// Runs for at least the given number of cycles, returning the cycles run
+	unsigned int RunCycles(unsigned int nCycles);
+
+	// Runs a single instruction, returning the cycles it took
+	unsigned int Step();
+
+	// Screen data, 160x144 Colours a row at a time. ConvertScreen turns it
+	// into RGBA, and PackScreen into 2 bits a pixel.
+	const uint8_t* GetFramebuffer();
+
+	// Bit n is set if Key n is held
+	void SetInput(uint8_t keys);
+	uint8_t GetInput();
+
+	// Why the machine stopped, if it has (m_CPU.m_bCrashed). Faults only ever
+	// stop this machine, never the program running it.
+	const Fault& GetFault();
+
+	// Snapshots are taken between instructions, and restoring one fails if
+	// it's for a different ROM or version
+	void Snapshot(MachineState& state);
+	bool Restore(const MachineState& state);
+
+	// A new machine in exactly this state, which then runs on its own. The
+	// ROM is shared rather than loaded again, so a fork only costs a copy of
+	// the state and can be made thousands of times a second.
+	std::unique_ptr<Machine> Fork();
+
+	// A hash of everything in a snapshot, so two machines in the same state
+	// hash the same however they got there. Cheap enough to take every frame.
+	uint64_t GetStateHash();
+
+	// A hash of the screen's shades, which are only kept up to date while
+	// the GPU is rendering
+	uint64_t GetScreenHash();
+
+	// Save states on disk, which are loaded by mapping the file
+	bool SaveState(const std::string& sFileName);
+	bool LoadState(const std::string& sFileName);
+
+	CPU m_CPU;
+
+	// Host time spent on each frame, and where it went
+	Profiler m_Profiler;
+
+private:
+
+	uint32_t m_RomHash;
+	unsigned int m_nLastTicks;
+	uint8_t m_Input;
+	bool m_bVblank;
+};
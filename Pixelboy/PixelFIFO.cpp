@@ -0,0 +1,305 @@
+#include "PixelFIFO.h"
+
+#include "GPU.h"
+
+void PixelFIFO::StartFrame()
+{
+	m_WindowLine = 0;
+	m_bWindowYReached = false;
+}
+
+void PixelFIFO::StartLine(GPU& gpu, bool bDraw)
+{
+	m_Scanline = gpu.m_Scanline;
+	m_bDraw = bDraw;
+
+	// OAM scan - the first 10 sprites which are on this line
+	const int ysize = (gpu.m_Control & 0b100) ? 16 : 8;
+	m_nLineSprites = 0;
+	for (int sprite = 0; sprite < 40 && m_nLineSprites < 10; sprite++)
+	{
+		const uint8_t* attributes = &gpu.m_Oam[sprite * 4];
+		if (m_Scanline + 16 >= attributes[0] && m_Scanline + 16 < attributes[0] + ysize)
+		{
+			Sprite& lineSprite = m_LineSprites[m_nLineSprites++];
+			lineSprite.y = attributes[0];
+			lineSprite.x = attributes[1];
+			lineSprite.tile = attributes[2];
+			lineSprite.attributes = attributes[3];
+			lineSprite.bFetched = false;
+		}
+	}
+	m_FetchingSprite = -1;
+	m_SpriteDots = 0;
+
+	// The window only shows once LY has matched WY this frame
+	if (m_Scanline == gpu.m_WindowY) m_bWindowYReached = true;
+	m_bWindow = false;
+	m_bWindowOnLine = false;
+
+	m_FetchStep = FETCH_TILE;
+	m_FetchDots = 0;
+	m_FetchX = 0;
+	m_bFirstFetch = true;
+
+	m_BackgroundHead = 0;
+	m_BackgroundSize = 0;
+	m_SpriteHead = 0;
+	m_SpriteSize = 0;
+
+	m_X = 0;
+	m_Discard = gpu.m_ScrollX & 7;
+	m_LineCycles = 0;
+	m_bLineDone = false;
+}
+
+int PixelFIFO::Step(GPU& gpu, int cycles)
+{
+	int used = 0;
+	while (used < cycles && !m_bLineDone)
+	{
+		Dot(gpu);
+		used++;
+	}
+	return used;
+}
+
+bool PixelFIFO::IsLineDone()
+{
+	return m_bLineDone;
+}
+
+int PixelFIFO::GetLineCycles()
+{
+	return m_LineCycles;
+}
+
+void PixelFIFO::Dot(GPU& gpu)
+{
+	m_LineCycles++;
+
+	// A sprite waits for the background fetch to finish, then takes 6 dots
+	if (m_FetchingSprite != -1)
+	{
+		if (m_FetchStep != FETCH_PUSH) { Fetch(gpu); return; }
+		if (++m_SpriteDots < 6) return;
+
+		FetchSprite(gpu, m_LineSprites[m_FetchingSprite]);
+		m_FetchingSprite = -1;
+		return;
+	}
+
+	if (m_Discard == 0)
+	{
+		// Start the window, which throws away the background so far
+		const bool bWindowEnabled = (gpu.m_Control & 0b100000) && m_bWindowYReached;
+		if (!m_bWindow && bWindowEnabled && m_X + 7 >= gpu.m_WindowX)
+		{
+			m_bWindow = true;
+			m_bWindowOnLine = true;
+			m_BackgroundSize = 0;
+			m_FetchStep = FETCH_TILE;
+			m_FetchDots = 0;
+			m_FetchX = 0;
+		}
+
+		// Any sprites starting here?
+		if (gpu.m_Control & 0b10)
+		{
+			m_FetchingSprite = GetSpriteToFetch();
+			if (m_FetchingSprite != -1)
+			{
+				m_SpriteDots = 0;
+				if (m_FetchStep != FETCH_PUSH) Fetch(gpu);
+				else m_SpriteDots++;
+				return;
+			}
+		}
+	}
+
+	Fetch(gpu);
+
+	// Shift out a pixel
+	if (m_BackgroundSize == 0) return;
+
+	if (m_Discard > 0)
+	{
+		m_BackgroundHead = (m_BackgroundHead + 1) & 15;
+		m_BackgroundSize--;
+		m_Discard--;
+		return;
+	}
+
+	DrawPixel(gpu);
+
+	if (++m_X == 160)
+	{
+		m_bLineDone = true;
+		if (m_bWindowOnLine) m_WindowLine++;
+	}
+}
+
+void PixelFIFO::Fetch(GPU& gpu)
+{
+	switch (m_FetchStep)
+	{
+		case FETCH_TILE:
+		{
+			if (++m_FetchDots < 2) return;
+			m_FetchDots = 0;
+
+			// Which tile map, and where in it?
+			uint16_t tileMap;
+			uint8_t x, y;
+			if (m_bWindow)
+			{
+				tileMap = (gpu.m_Control & 0b1000000) ? 0x9C00 : 0x9800;
+				x = m_FetchX & 31;
+				y = (uint8_t)m_WindowLine;
+			}
+			else
+			{
+				tileMap = (gpu.m_Control & 0b1000) ? 0x9C00 : 0x9800;
+				x = ((gpu.m_ScrollX >> 3) + m_FetchX) & 31;
+				y = m_Scanline + gpu.m_ScrollY;
+			}
+
+			uint8_t tileNumber = gpu.m_Vram[tileMap - 0x8000 + (y / 8) * 32 + x];
+
+			// 0x8000 uses unsigned tile numbers, 0x8800 signed ones around 0x9000
+			if (gpu.m_Control & 0b10000) m_TileAddress = 0x8000 + tileNumber * 16;
+			else m_TileAddress = 0x9000 + (int8_t)tileNumber * 16;
+			m_TileAddress += (y % 8) * 2;
+
+			m_FetchStep = FETCH_LOW;
+			break;
+		}
+
+		case FETCH_LOW:
+			if (++m_FetchDots < 2) return;
+			m_FetchDots = 0;
+			m_TileLow = gpu.m_Vram[m_TileAddress - 0x8000];
+			m_FetchStep = FETCH_HIGH;
+			break;
+
+		case FETCH_HIGH:
+			if (++m_FetchDots < 2) return;
+			m_FetchDots = 0;
+			m_TileHigh = gpu.m_Vram[m_TileAddress - 0x8000 + 1];
+
+			// The very first fetch of a line is thrown away
+			if (m_bFirstFetch)
+			{
+				m_bFirstFetch = false;
+				m_FetchStep = FETCH_TILE;
+			}
+			else m_FetchStep = FETCH_PUSH;
+			break;
+
+		case FETCH_PUSH:
+		{
+			if (m_BackgroundSize != 0) return;
+
+			// With the background off, it's drawn as colour 0
+			const bool bBackground = gpu.m_Control & 0b1;
+			for (int bit = 7; bit >= 0; bit--)
+			{
+				uint8_t colourNumber = (((m_TileHigh >> bit) & 1) << 1) | ((m_TileLow >> bit) & 1);
+				m_Background[(m_BackgroundHead + m_BackgroundSize) & 15] = bBackground ? colourNumber : 0;
+				m_BackgroundSize++;
+			}
+
+			m_FetchX++;
+			m_FetchStep = FETCH_TILE;
+			break;
+		}
+	}
+}
+
+bool PixelFIFO::IsValid() const
+{
+	// The tile address is only read between fetching the tile and its data
+	const bool bFetchingData = (m_FetchStep == FETCH_LOW || m_FetchStep == FETCH_HIGH);
+
+	return (unsigned int)m_FetchStep <= FETCH_PUSH
+		&& (!bFetchingData || (m_TileAddress >= 0x8000 && m_TileAddress < 0x9FFF))
+		&& m_BackgroundHead >= 0 && m_BackgroundHead < 16 && m_BackgroundSize >= 0 && m_BackgroundSize <= 16
+		&& m_SpriteHead >= 0 && m_SpriteHead < 8 && m_SpriteSize >= 0 && m_SpriteSize <= 8
+		&& m_nLineSprites >= 0 && m_nLineSprites <= 10 && m_FetchingSprite >= -1 && m_FetchingSprite < 10
+		&& m_Scanline < 144 && m_X >= 0 && (m_X < 160 || (m_X == 160 && m_bLineDone))
+		&& m_Discard >= 0 && m_Discard < 8;
+}
+
+int PixelFIFO::GetSpriteToFetch()
+{
+	// In OAM order, so earlier sprites win when they share an X position
+	for (int i = 0; i < m_nLineSprites; ++i)
+	{
+		const Sprite& sprite = m_LineSprites[i];
+		if (!sprite.bFetched && sprite.x <= m_X + 8) return i;
+	}
+	return -1;
+}
+
+void PixelFIFO::FetchSprite(GPU& gpu, Sprite& sprite)
+{
+	sprite.bFetched = true;
+
+	const int ysize = (gpu.m_Control & 0b100) ? 16 : 8;
+	uint8_t tile = sprite.tile;
+	if (ysize == 16) tile &= 0xFE;
+
+	// Kept within the sprite, in case the size changed after the OAM scan
+	int line = (m_Scanline + 16 - sprite.y) & (ysize - 1);
+	if (sprite.attributes & 0b1000000) line = ysize - 1 - line; // Y flip
+
+	const uint16_t address = tile * 16 + line * 2;
+	const uint8_t low = gpu.m_Vram[address];
+	const uint8_t high = gpu.m_Vram[address + 1];
+
+	// Sprites partly off the left of the screen lose their first pixels
+	const int skip = (sprite.x < 8) ? 8 - sprite.x : 0;
+
+	for (int pixel = skip; pixel < 8; ++pixel)
+	{
+		const int bit = (sprite.attributes & 0b100000) ? pixel : 7 - pixel; // X flip
+		const uint8_t colourNumber = (((high >> bit) & 1) << 1) | ((low >> bit) & 1);
+
+		// Sprites already in the FIFO have priority, unless they're transparent
+		const int slot = pixel - skip;
+		SpritePixel& destination = m_Sprites[(m_SpriteHead + slot) & 7];
+		if (slot < m_SpriteSize)
+		{
+			if (destination.colour != 0) continue;
+		}
+		else m_SpriteSize++;
+
+		destination.colour = colourNumber;
+		destination.attributes = sprite.attributes;
+	}
+}
+
+void PixelFIFO::DrawPixel(GPU& gpu)
+{
+	uint8_t colourNumber = m_Background[m_BackgroundHead];
+	uint8_t palette = gpu.m_BackgroundPalette;
+	m_BackgroundHead = (m_BackgroundHead + 1) & 15;
+	m_BackgroundSize--;
+
+	if (m_SpriteSize > 0)
+	{
+		const SpritePixel sprite = m_Sprites[m_SpriteHead];
+		m_SpriteHead = (m_SpriteHead + 1) & 7;
+		m_SpriteSize--;
+
+		// Sprites behind the background only show over colour 0
+		const bool bBehind = sprite.attributes & 0b10000000;
+		if (sprite.colour != 0 && (gpu.m_Control & 0b10) && (!bBehind || colourNumber == 0))
+		{
+			colourNumber = sprite.colour;
+			palette = (sprite.attributes & 0b10000) ? gpu.m_SpritePalettes[1] : gpu.m_SpritePalettes[0];
+		}
+	}
+
+	if (m_bDraw) gpu.WritePixel(m_X, m_Scanline, colourNumber, palette);
+}
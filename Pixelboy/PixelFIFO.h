@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+class GPU;
+
+/*
+	Dot by dot model of the pixel transfer (mode 3), as used by the real
+	hardware rather than drawing a whole line at once:
+		- The fetcher reads a tile number, then the two bytes of tile data
+		  (2 dots each), and pushes 8 pixels once the background FIFO is empty
+		- Every dot one pixel leaves the background FIFO, mixed with the
+		  sprite FIFO, and is drawn with whatever the registers are right now
+		- SCX & 7 pixels are thrown away at the start of the line, the
+		  window restarts the fetcher, and each sprite stalls the transfer
+		  whilst it's fetched
+	The transfer ends once 160 pixels have been drawn. There are no pointers,
+	so it can be copied as part of the GPU's state.
+	https://gbdev.io/pandocs/pixel_fifo.html
+*/
+
+class PixelFIFO
+{
+public:
+
+	void StartFrame();
+	void StartLine(GPU& gpu, bool bDraw);
+
+	// Runs for up to the given number of dots, returning how many were used
+	int Step(GPU& gpu, int cycles);
+
+	bool IsLineDone();
+	int GetLineCycles();
+
+	// Whether everything used as an index is in range, for states which
+	// might be damaged
+	bool IsValid() const;
+
+private:
+
+	enum FetchStep
+	{
+		FETCH_TILE,
+		FETCH_LOW,
+		FETCH_HIGH,
+		FETCH_PUSH
+	};
+
+	struct Sprite
+	{
+		uint8_t y;
+		uint8_t x;
+		uint8_t tile;
+		uint8_t attributes;
+		bool bFetched;
+	};
+
+	struct SpritePixel
+	{
+		uint8_t colour;
+		uint8_t attributes;
+	};
+
+	void Dot(GPU& gpu);
+	void Fetch(GPU& gpu);
+	void FetchSprite(GPU& gpu, Sprite& sprite);
+	void DrawPixel(GPU& gpu);
+	int GetSpriteToFetch();
+
+	// Background/window fetcher
+	FetchStep m_FetchStep;
+	int m_FetchDots;
+	uint8_t m_FetchX;
+	uint8_t m_TileLow;
+	uint8_t m_TileHigh;
+	uint16_t m_TileAddress;
+	bool m_bFirstFetch;
+
+	// Background FIFO (colour numbers)
+	uint8_t m_Background[16];
+	int m_BackgroundHead;
+	int m_BackgroundSize;
+
+	// Sprite FIFO
+	SpritePixel m_Sprites[8];
+	int m_SpriteHead;
+	int m_SpriteSize;
+
+	// Sprites on this line, found during the OAM scan
+	Sprite m_LineSprites[10];
+	int m_nLineSprites;
+	int m_FetchingSprite; // index, or -1 if none
+	int m_SpriteDots;
+
+	// Window
+	bool m_bWindow;
+	bool m_bWindowYReached;
+	int m_WindowLine;
+	bool m_bWindowOnLine;
+
+	uint8_t m_Scanline;
+	int m_X;
+	int m_Discard;
+	int m_LineCycles;
+	bool m_bDraw;
+	bool m_bLineDone;
+};
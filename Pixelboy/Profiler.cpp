@@ -0,0 +1,138 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PROFILE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+static int64_t GetNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::Profiler()
+{
+	for (uint64_t& ticks : m_Ticks) ticks = 0;
+	m_nInstructions = 0;
+	m_nTimedInstructions = 0;
+	m_FrameStart = 0;
+	m_nFrames = 0;
+
+	// The quickest of a few tries is the least disturbed
+	m_TimerOverhead = UINT64_MAX;
+	for (int i = 0; i < 64; ++i)
+	{
+		const uint64_t start = ReadTimestamp();
+		m_TimerOverhead = std::min(m_TimerOverhead, ReadTimestamp() - start);
+	}
+
+	m_CalibrationTicks = ReadTimestamp();
+	m_CalibrationNanoseconds = GetNanoseconds();
+}
+
+uint64_t Profiler::ReadTimestamp()
+{
+	// The timestamp counter costs a few cycles, where the steady clock may be a system call
+#ifdef PROFILE_TSC
+	return __rdtsc();
+#else
+	return (uint64_t)GetNanoseconds();
+#endif
+}
+
+void Profiler::StartFrame()
+{
+	m_FrameStart = ReadTimestamp();
+}
+
+void Profiler::EndFrame()
+{
+	const uint64_t end = ReadTimestamp();
+
+	// Make up for the instructions which weren't timed
+	const double scale = (m_nTimedInstructions != 0) ? (double)m_nInstructions / m_nTimedInstructions : 1.0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		FrameRecord& record = m_History[m_nFrames & (PROFILE_HISTORY - 1)];
+		record.end = end;
+		record.ticks = end - m_FrameStart;
+		for (int section = 0; section < PROFILE_SECTIONS; ++section) record.sectionTicks[section] = (uint64_t)(m_Ticks[section] * scale);
+		record.nInstructions = m_nInstructions;
+		m_nFrames++;
+	}
+
+	for (uint64_t& ticks : m_Ticks) ticks = 0;
+	m_nInstructions = 0;
+	m_nTimedInstructions = 0;
+}
+
+ProfileStats Profiler::GetStats()
+{
+	ProfileStats stats = {};
+
+	FrameRecord history[PROFILE_HISTORY];
+	unsigned int nFrames;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		nFrames = std::min(m_nFrames, (unsigned int)PROFILE_HISTORY);
+
+		// Oldest first
+		for (unsigned int i = 0; i < nFrames; ++i) history[i] = m_History[(m_nFrames - nFrames + i) & (PROFILE_HISTORY - 1)];
+	}
+
+	stats.nFrames = nFrames;
+	if (nFrames == 0) return stats;
+
+	const double ticksPerMillisecond = GetTicksPerMillisecond();
+
+	double frameMilliseconds[PROFILE_HISTORY];
+	uint64_t nInstructions = 0;
+	for (unsigned int i = 0; i < nFrames; ++i)
+	{
+		for (int section = 0; section < PROFILE_SECTIONS; ++section) stats.sectionMilliseconds[section] += history[i].sectionTicks[section] / ticksPerMillisecond / nFrames;
+		frameMilliseconds[i] = history[i].ticks / ticksPerMillisecond;
+		if (i > 0) nInstructions += history[i].nInstructions;
+	}
+
+	// Rates need at least two frames to measure between
+	if (nFrames > 1)
+	{
+		const double seconds = (history[nFrames - 1].end - history[0].end) / ticksPerMillisecond / 1000.0;
+		stats.framesPerSecond = (nFrames - 1) / seconds;
+		stats.instructionsPerSecond = nInstructions / seconds;
+	}
+
+	// The histogram reaches a little past the slowest frames
+	double sorted[PROFILE_HISTORY];
+	std::copy(frameMilliseconds, frameMilliseconds + nFrames, sorted);
+	std::sort(sorted, sorted + nFrames);
+	stats.frameMilliseconds50 = sorted[nFrames / 2];
+	stats.frameMilliseconds99 = sorted[std::min(nFrames - 1, nFrames * 99 / 100)];
+
+	stats.histogramMilliseconds = std::max(sorted[nFrames - 1] * 1.25, 0.001) / PROFILE_HISTOGRAM_BUCKETS;
+	for (unsigned int i = 0; i < nFrames; ++i)
+	{
+		const int bucket = std::min((int)(frameMilliseconds[i] / stats.histogramMilliseconds), PROFILE_HISTOGRAM_BUCKETS - 1);
+		stats.histogram[bucket]++;
+	}
+
+	return stats;
+}
+
+double Profiler::GetTicksPerMillisecond()
+{
+	// Measured against the steady clock since we were made, so it sharpens over time
+	const int64_t nanoseconds = GetNanoseconds() - m_CalibrationNanoseconds;
+	if (nanoseconds <= 0) return 1000000.0;
+
+	return (ReadTimestamp() - m_CalibrationTicks) / (nanoseconds / 1000000.0);
+}
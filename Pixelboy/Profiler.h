@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+
+/*
+	Where the host's time goes, frame by frame. Sections are timed with the
+	CPU's timestamp counter by PROFILE_SCOPE, which only exists when built
+	with PIXELBOY_PROFILE defined - otherwise it compiles to nothing and
+	only whole frames are timed. Reading the counter costs about as much as
+	emulating an instruction, so only one in PROFILE_SAMPLE_INTERVAL
+	instructions is timed, and the totals scaled up to match. Each Profiler
+	is written by one thread, and can be read from any other.
+*/
+
+enum ProfileSection
+{
+	PROFILE_CPU,		// executing instructions
+	PROFILE_GPU,		// mode state machine and rendering
+	PROFILE_INTERRUPTS,	// timers and interrupt handling
+	PROFILE_PRESENT,	// uploading and showing frames
+	PROFILE_SECTIONS
+};
+
+#define PROFILE_HISTORY 256 // frames, which must be a power of 2
+#define PROFILE_HISTOGRAM_BUCKETS 32
+#define PROFILE_SAMPLE_INTERVAL 16 // must be a power of 2
+
+struct ProfileStats
+{
+	unsigned int nFrames;
+
+	// Averages over the frames in the history, in milliseconds
+	double sectionMilliseconds[PROFILE_SECTIONS];
+
+	// Host time spent on each frame, in milliseconds
+	double frameMilliseconds50;
+	double frameMilliseconds99;
+
+	double framesPerSecond; // real time, including any waiting
+	double instructionsPerSecond;
+
+	// Frame times from 0 to PROFILE_HISTOGRAM_BUCKETS * histogramMilliseconds
+	unsigned int histogram[PROFILE_HISTOGRAM_BUCKETS];
+	double histogramMilliseconds;
+};
+
+class Profiler
+{
+public:
+
+	Profiler();
+
+	static uint64_t ReadTimestamp();
+
+	// Takes off the cost of reading the timestamp, which is there even for empty scopes
+	void Add(ProfileSection section, uint64_t ticks) { m_Ticks[section] += (ticks > m_TimerOverhead) ? ticks - m_TimerOverhead : 0; }
+
+	// Counts an instruction, returning true if it's one to time
+	bool CountInstruction()
+	{
+		if ((++m_nInstructions & (PROFILE_SAMPLE_INTERVAL - 1)) != 0) return false;
+		m_nTimedInstructions++;
+		return true;
+	}
+
+	// Frames are timed from StartFrame to EndFrame
+	void StartFrame();
+	void EndFrame();
+
+	ProfileStats GetStats();
+
+private:
+
+	struct FrameRecord
+	{
+		uint64_t end; // timestamp
+		uint64_t ticks;
+		uint64_t sectionTicks[PROFILE_SECTIONS];
+		uint64_t nInstructions;
+	};
+
+	double GetTicksPerMillisecond();
+
+	// Accumulating for the current frame
+	uint64_t m_Ticks[PROFILE_SECTIONS];
+	uint64_t m_nInstructions;
+	uint64_t m_nTimedInstructions;
+	uint64_t m_FrameStart;
+
+	std::mutex m_Mutex;
+	FrameRecord m_History[PROFILE_HISTORY];
+	unsigned int m_nFrames;
+
+	uint64_t m_TimerOverhead;
+
+	// For converting timestamps into real time
+	uint64_t m_CalibrationTicks;
+	int64_t m_CalibrationNanoseconds;
+};
+
+// Adds the time until the end of the scope to a section, if enabled
+class ScopedTimer
+{
+public:
+
+	ScopedTimer(Profiler& profiler, ProfileSection section, bool bEnabled) : m_Profiler(profiler), m_Section(section), m_bEnabled(bEnabled)
+	{
+		if (m_bEnabled) m_Start = Profiler::ReadTimestamp();
+	}
+
+	~ScopedTimer()
+	{
+		if (m_bEnabled) m_Profiler.Add(m_Section, Profiler::ReadTimestamp() - m_Start);
+	}
+
+private:
+
+	Profiler& m_Profiler;
+	ProfileSection m_Section;
+	bool m_bEnabled;
+	uint64_t m_Start;
+};
+
+#ifdef PIXELBOY_PROFILE
+#define PROFILE_CONCATENATE(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_CONCATENATE(scopedTimer, line)
+#define PROFILE_SCOPE(profiler, section, bEnabled) ScopedTimer PROFILE_NAME(__LINE__)(profiler, section, bEnabled)
+#else
+#define PROFILE_SCOPE(profiler, section, bEnabled) (void)sizeof(bEnabled)
+#endif
@@ -1,10 +1,9 @@
 #include "RAM.h"
 
-#include <iostream>
-#include <sstream>
 #include <cstring>
 
 #include "Cartridge.h"
+#include "CPU.h"
 
 // State of IO memory at boot time
 const uint8_t ioReset[0x100] = 
@@ -27,21 +26,8 @@ const uint8_t ioReset[0x100] =
 	0x98, 0xD1, 0x71, 0x02, 0x4D, 0x01, 0xC1, 0xFF, 0x0D, 0x00, 0xD3, 0x05, 0xF9, 0x00, 0x0B, 0x00
 };
 
-Memory::Memory(const std::string& sBootRom, const std::string& sFileName) : m_BootRom(sBootRom), m_Cartridge(sFileName), m_GPU(m_Vram, m_Oam)
+void Memory::Reset(bool bBootRom)
 {
-	Reset(sFileName, true);
-}
-
-Memory::Memory(const std::string& sFileName) : m_Cartridge(sFileName), m_GPU(m_Vram, m_Oam)
-{
-	Reset(sFileName, false);
-}
-
-void Memory::Reset(const std::string& sFileName, bool bBootRom)
-{
-	// Load ROM if need be
-	if (m_Cartridge.m_Memory == nullptr) m_Cartridge.Reset(sFileName);
-
 	// Zero out memory and copy for IO
 	memset(m_Sram, 0, sizeof(m_Sram));
 	memcpy(m_Io, ioReset, sizeof(m_Io));
@@ -86,6 +72,8 @@ void Memory::Reset(const std::string& sFileName, bool bBootRom)
 	m_DividerRegister = 0;
 	m_DividerCounter = 0;
 	m_TimerCounter = 1024;
+
+	m_Fault = { FAULT_NONE, 0, 0 };
 }
 
 /*
@@ -104,13 +92,31 @@ void Memory::Reset(const std::string& sFileName, bool bBootRom)
 		FFFF Interrupt Enable Register
 */
 
-uint8_t Memory::ReadByte(uint16_t address)
+const char* GetFaultName(FaultReason reason)
 {
-	auto hexToString = [](int hex)
+	switch (reason)
 	{
-		return (static_cast<std::stringstream const&>(std::stringstream() << "0x" << std::hex << hex)).str();
-	};
+		case FAULT_NONE: return "none";
+		case FAULT_INVALID_OPCODE: return "invalid-opcode";
+		case FAULT_UNMAPPED_READ: return "unmapped-read";
+	}
+	return "unknown";
+}
 
+#if defined(__GNUC__)
+__attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+__declspec(noinline)
+#endif
+uint8_t Memory::RaiseFault(FaultReason reason, uint16_t address)
+{
+	// The CPU fills in where it was
+	if (m_Fault.reason == FAULT_NONE) m_Fault = { reason, address, 0 };
+	return 0xFF;
+}
+
+uint8_t Memory::ReadByte(uint16_t address)
+{
 	if (address < 0x8000) // Cartridge memory
 	{
 		if (m_bBootRom && address < 256) return m_BootRom.m_Memory[address];
@@ -196,22 +202,19 @@ uint8_t Memory::ReadByte(uint16_t address)
 	else if (address == 0xFF06) return m_TimerResetValue;
 	else if (address == 0xFF07) return m_TimerFrequency;
 
-	std::cerr << "Invalid memory address " << hexToString(address) << std::endl;
-	exit(-1);
-	return 0;
+	return RaiseFault(FAULT_UNMAPPED_READ, address);
 }
 
 void Memory::WriteByte(uint16_t address, uint8_t data)
 {
-	auto hexToString = [](int hex)
-	{
-		return (static_cast<std::stringstream const&>(std::stringstream() << "0x" << std::hex << hex)).str();
-	};
-
 	// Banking
 	if (address < 0x8000) HandleBanking(address, data);
 
-	else if (address >= 0x8000 && address <= 0x9fff) m_Vram[address - 0x8000] = data;
+	else if (address >= 0x8000 && address <= 0x9fff)
+	{
+		m_Vram[address - 0x8000] = data;
+		m_GPU.m_bVideoMemoryDirty = true;
+	}
 
 	// Banking
 	else if ((address >= 0xA000) && (address < 0xC000))
@@ -224,22 +227,24 @@ void Memory::WriteByte(uint16_t address, uint8_t data)
 	}
 
 	else if (address >= 0xC000 && address <= 0xDFFF) m_Wram[address - 0xC000] = data;
-	else if (address >= 0xE000 && address <= 0xFDFF) 
+	else if (address >= 0xE000 && address <= 0xFDFF) m_Wram[address - 0xE000] = data; // Echo RAM
+	else if (address >= 0xFE00 && address <= 0xFEFF)
 	{
-		// Echo RAM
-		m_Wram[address - 0xE000 - 0x2000] = data; 
-		m_Wram[address - 0xE000] = data;
+		m_Oam[address - 0xFE00] = data;
+		m_GPU.m_bVideoMemoryDirty = true;
 	}
-	else if (address >= 0xFE00 && address <= 0xFEFF) m_Oam[address - 0xFE00] = data;
 	else if (address >= 0xFF80 && address <= 0xFFFE) m_Hram[address - 0xFF80] = data;
 
 	// GPU and LCD
 	else if (address == 0xff40) m_GPU.m_Control = data;
-	else if (address == 0xff41) m_GPU.m_LCDStatus = data;
+	else if (address == 0xff41) m_GPU.WriteStatus(data);
 	else if (address == 0xff42) m_GPU.m_ScrollY = data;
 	else if (address == 0xff43) m_GPU.m_ScrollX = data;
 	else if (address == 0xff44) m_GPU.m_Scanline = 0; // reset if trying to write
-	else if (address == 0xff45) m_GPU.m_Coincidence = data;
+	else if (address == 0xff45)
+	{
+		if (m_GPU.WriteCoincidence(data)) m_InterruptFlags |= LCD_FLAG_BIT;
+	}
 	else if (address == 0xff4A) m_GPU.m_WindowY = data;
 	else if (address == 0xff4B) m_GPU.m_WindowX = data;
 
@@ -394,8 +399,9 @@ void Memory::DoChangeHiROMBank(uint8_t data)
 	// turn off the upper 3 bits of the current rom
 	m_CurrentROMBank &= 31;
 
-	// turn off the lower 5 bits of the data
-	data &= 224;
+	// turn off the lower 5 bits of the data, and the top one too, as only
+	// 128 banks fit in the cartridge
+	data &= 96;
 	m_CurrentROMBank |= data;
 	if (m_CurrentROMBank == 0) m_CurrentROMBank++;
 }
@@ -19,25 +19,35 @@
 		FFFF Interrupt Enable Register
 */
 
-class Memory
+// Why a machine stopped. Nothing a ROM does can take the host down: what it
+// reads and writes is kept inside the machine's memory, and the GPU's buffers
+// are bounded however it drives LY (see GPU::CaptureScanLine). Anything the
+// emulator can't carry on from stops the machine with a fault instead, for
+// whatever is running it to see.
+enum FaultReason : uint8_t
 {
-public:
-
-	Memory(const std::string& sBootRom, const std::string& sFileName);
-	Memory(const std::string& sFileName);
-	Memory() {};
-	void Reset(const std::string& sFileName, bool bBootRom);
-	~Memory();
-
-	uint8_t ReadByte(uint16_t address);
-	void WriteByte(uint16_t address, uint8_t data);
+	FAULT_NONE,
+	FAULT_INVALID_OPCODE,	// one of the 11 the GameBoy doesn't have
+	// Nothing answered, so it read open bus (0xFF). Nothing raises this yet,
+	// as every address is mapped (FEA0-FEFF reads OAM's spare bytes, which
+	// games do read), so it only guards the end of Memory::ReadByte.
+	FAULT_UNMAPPED_READ
+};
 
-	void WriteShortToStack(uint16_t* stackPointer, uint16_t address);
-	uint16_t ReadShortFromStack(uint16_t* stackPointer);
+struct Fault
+{
+	FaultReason reason;
+	uint16_t address; // of the read, or the opcode
+	uint16_t programCounter; // of the instruction which faulted
+};
 
-	void WriteShort(uint16_t address, uint16_t value);
-	uint16_t ReadShort(uint16_t address);
+const char* GetFaultName(FaultReason reason);
 
+// Everything in memory which changes as it runs - RAM, registers, banking
+// and timers - with no pointers, so it can be copied straight into and out
+// of a save state. The cartridge ROM never changes, so isn't part of it.
+struct MemoryState
+{
 	// Banking
 	bool m_bBanking;
 	uint8_t m_RamBanks[0x8000];
@@ -54,9 +64,6 @@ public:
 	uint8_t m_JoypadState;
 	uint8_t m_JoypadReq;
 
-	// Graphics
-	GPU m_GPU;
-
 	uint8_t m_Sram[0x2000];
 	uint8_t m_Io[0x100];
 	uint8_t m_Vram[0x2000];
@@ -76,6 +83,36 @@ public:
 
 	bool m_bBootRom;
 
+	// The first fault, if any, which the CPU stops on once the instruction is done
+	Fault m_Fault;
+};
+
+class Memory : public MemoryState
+{
+public:
+
+	Memory() {};
+
+	// The cartridge is loaded beforehand, with Cartridge::Reset
+	void Reset(bool bBootRom);
+	~Memory();
+
+	uint8_t ReadByte(uint16_t address);
+	void WriteByte(uint16_t address, uint8_t data);
+
+	void WriteShortToStack(uint16_t* stackPointer, uint16_t address);
+	uint16_t ReadShortFromStack(uint16_t* stackPointer);
+
+	void WriteShort(uint16_t address, uint16_t value);
+	uint16_t ReadShort(uint16_t address);
+
+	// Notes down a fault, returning open bus for reads to hand back. Kept
+	// out of line, as only broken ROMs ever get here.
+	uint8_t RaiseFault(FaultReason reason, uint16_t address);
+
+	// Graphics
+	GPU m_GPU;
+
 	Cartridge m_Cartridge;
 
 private:
@@ -0,0 +1,265 @@
+#include "Rewind.h"
+
+#include <cstring>
+#include <utility>
+
+// The codec's hash table, indexed by the next four bytes
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xFFFF
+
+Rewind::Rewind(size_t nBytes)
+{
+	m_Latest.reset(new MachineState);
+	m_Current.reset(new MachineState);
+	m_Compressed.resize(GetMaxCompressedSize(sizeof(MachineState)));
+
+	SetSize(nBytes);
+}
+
+void Rewind::SetSize(size_t nBytes)
+{
+	// Not zeroed, so pages are only used once history reaches them
+	m_Buffer.reset(nBytes > 0 ? new uint8_t[nBytes] : nullptr);
+	m_nSize = nBytes;
+	Clear();
+}
+
+bool Rewind::IsEnabled()
+{
+	return m_nSize > 0;
+}
+
+void Rewind::Clear()
+{
+	m_Entries.clear();
+	m_nHead = 0;
+	m_nBytesUsed = 0;
+	m_bHasLatest = false;
+	m_nFramesSinceCapture = 0;
+}
+
+void Rewind::Capture(Machine& machine)
+{
+	if (!IsEnabled()) return;
+	if (m_bHasLatest && ++m_nFramesSinceCapture < REWIND_INTERVAL) return;
+
+	machine.Snapshot(*m_Current);
+
+	if (m_bHasLatest)
+	{
+		// The latest snapshot becomes the difference between it and this one
+		uint8_t* latest = (uint8_t*)m_Latest.get();
+		const uint8_t* current = (const uint8_t*)m_Current.get();
+		size_t i = 0;
+		for (; i + 8 <= sizeof(MachineState); i += 8)
+		{
+			uint64_t a, b;
+			memcpy(&a, latest + i, 8);
+			memcpy(&b, current + i, 8);
+			a ^= b;
+			memcpy(latest + i, &a, 8);
+		}
+		for (; i < sizeof(MachineState); ++i) latest[i] ^= current[i];
+
+		Store(m_Compressed.data(), Compress(latest, sizeof(MachineState), m_Compressed.data()));
+	}
+
+	std::swap(m_Latest, m_Current);
+	m_bHasLatest = true;
+	m_nFramesSinceCapture = 0;
+}
+
+bool Rewind::StepBack(Machine& machine)
+{
+	if (!m_bHasLatest) return false;
+
+	// If the machine has moved on since the last snapshot, go back to that
+	// first. Otherwise undo the newest difference.
+	bool bStepped = true;
+	if (m_nFramesSinceCapture == 0)
+	{
+		if (m_Entries.empty()) bStepped = false;
+		else
+		{
+			const Entry entry = m_Entries.back();
+			m_Entries.pop_back();
+			m_nHead = entry.offset;
+			m_nBytesUsed -= entry.size;
+
+			Decompress(&m_Buffer[entry.offset], entry.size, (uint8_t*)m_Current.get(), sizeof(MachineState));
+
+			uint8_t* latest = (uint8_t*)m_Latest.get();
+			const uint8_t* difference = (const uint8_t*)m_Current.get();
+			for (size_t i = 0; i < sizeof(MachineState); ++i) latest[i] ^= difference[i];
+		}
+	}
+
+	machine.Restore(*m_Latest);
+	machine.RunFrame();
+	m_nFramesSinceCapture = 0;
+
+	return bStepped;
+}
+
+double Rewind::GetSeconds()
+{
+	return m_Entries.size() * REWIND_INTERVAL / FRAMES_PER_SECOND;
+}
+
+size_t Rewind::GetBytesUsed()
+{
+	return m_nBytesUsed;
+}
+
+void Rewind::Store(const uint8_t* data, size_t size)
+{
+	// Too big to ever fit, so the history can't go back past here
+	if (size > m_nSize)
+	{
+		m_Entries.clear();
+		m_nHead = 0;
+		m_nBytesUsed = 0;
+		return;
+	}
+
+	auto DropOldest = [&]()
+	{
+		m_nBytesUsed -= m_Entries.front().size;
+		m_Entries.pop_front();
+	};
+
+	// Anything after the head is older than everything before it, so if
+	// there's no room before the end, that all goes and we wrap around
+	size_t start = m_nHead;
+	if (start + size > m_nSize)
+	{
+		while (!m_Entries.empty() && m_Entries.front().offset >= m_nHead) DropOldest();
+		start = 0;
+	}
+
+	// Make room by dropping the oldest snapshots in the way
+	while (!m_Entries.empty() && m_Entries.front().offset < start + size && m_Entries.front().offset + m_Entries.front().size > start) DropOldest();
+
+	memcpy(&m_Buffer[start], data, size);
+	m_Entries.push_back({ start, size });
+	m_nHead = start + size;
+	m_nBytesUsed += size;
+}
+
+/*
+	The codec is LZ77 in the style of LZ4. Each sequence is a token (four bits
+	of literal count, four of match length), the literals, then where the
+	match is as a 16 bit offset back. Counts of 15 or more carry on in extra
+	bytes. The last sequence is only literals. Runs of zeros, which is most
+	of an XOR, become matches one byte back.
+*/
+
+size_t Rewind::Compress(const uint8_t* input, size_t size, uint8_t* output)
+{
+	uint32_t table[1 << LZ_HASH_BITS] = {};
+	uint8_t* out = output;
+
+	auto WriteCount = [&](size_t count)
+	{
+		for (; count >= 255; count -= 255) *out++ = 255;
+		*out++ = (uint8_t)count;
+	};
+
+	auto WriteSequence = [&](const uint8_t* literals, size_t nLiterals, size_t offset, size_t length)
+	{
+		const size_t extra = (length > 0) ? length - LZ_MIN_MATCH : 0;
+		*out++ = (uint8_t)(((nLiterals < 15 ? nLiterals : 15) << 4) | (extra < 15 ? extra : 15));
+		if (nLiterals >= 15) WriteCount(nLiterals - 15);
+		memcpy(out, literals, nLiterals);
+		out += nLiterals;
+
+		if (length == 0) return;
+		*out++ = offset & 0xFF;
+		*out++ = (offset >> 8) & 0xFF;
+		if (extra >= 15) WriteCount(extra - 15);
+	};
+
+	size_t anchor = 0;
+	size_t i = 0;
+	while (i + LZ_MIN_MATCH <= size)
+	{
+		uint32_t sequence;
+		memcpy(&sequence, input + i, 4);
+		const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+		const size_t candidate = table[hash];
+		table[hash] = (uint32_t)i;
+
+		if (candidate >= i || i - candidate > LZ_MAX_OFFSET || memcmp(input + candidate, input + i, LZ_MIN_MATCH) != 0)
+		{
+			++i;
+			continue;
+		}
+
+		// Extend the match eight bytes at a time, then one at a time
+		size_t length = LZ_MIN_MATCH;
+		for (; i + length + 8 <= size; length += 8)
+		{
+			uint64_t a, b;
+			memcpy(&a, input + candidate + length, 8);
+			memcpy(&b, input + i + length, 8);
+			if (a != b) break;
+		}
+		while (i + length < size && input[candidate + length] == input[i + length]) ++length;
+
+		WriteSequence(input + anchor, i - anchor, i - candidate, length);
+		i += length;
+		anchor = i;
+	}
+
+	WriteSequence(input + anchor, size - anchor, 0, 0);
+	return out - output;
+}
+
+void Rewind::Decompress(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize)
+{
+	const uint8_t* end = input + size;
+	uint8_t* out = output;
+	uint8_t* outEnd = output + outputSize;
+
+	auto ReadCount = [&]()
+	{
+		size_t count = 0;
+		uint8_t byte;
+		do
+		{
+			byte = *input++;
+			count += byte;
+		} while (byte == 255);
+		return count;
+	};
+
+	while (input < end && out < outEnd)
+	{
+		const uint8_t token = *input++;
+
+		size_t nLiterals = token >> 4;
+		if (nLiterals == 15) nLiterals += ReadCount();
+		memcpy(out, input, nLiterals);
+		input += nLiterals;
+		out += nLiterals;
+		if (out >= outEnd) break;
+
+		const size_t offset = input[0] | (input[1] << 8);
+		input += 2;
+		size_t length = token & 0x0F;
+		if (length == 15) length += ReadCount();
+		length += LZ_MIN_MATCH;
+
+		// Byte by byte, as matches can overlap what they're copying
+		const uint8_t* match = out - offset;
+		for (size_t n = 0; n < length; ++n) out[n] = match[n];
+		out += length;
+	}
+}
+
+size_t Rewind::GetMaxCompressedSize(size_t size)
+{
+	// All literals, plus the bytes counting them
+	return size + size / 255 + 16;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "Machine.h"
+
+// Default history, which holds well over a minute for most games
+#define REWIND_DEFAULT_MEGABYTES 32
+
+// Frames between snapshots. Rewinding steps back one snapshot a frame, so
+// it plays back this many times faster than the game ran.
+#define REWIND_INTERVAL 2
+
+/*
+	Rewinding, from a ring of machine snapshots. Only the newest snapshot is
+	kept whole; each one before it is stored as the XOR of it and the one
+	after, compressed with a small LZ codec. Most of a machine doesn't change
+	between snapshots, so the XOR is mostly zeros and shrinks to a few
+	hundred bytes. Stepping back undoes the newest difference. The ring never
+	grows past its size - the oldest snapshots are dropped instead.
+*/
+
+class Rewind
+{
+public:
+
+	// A size of 0 turns rewinding off
+	Rewind(size_t nBytes = REWIND_DEFAULT_MEGABYTES * 1024 * 1024);
+
+	void SetSize(size_t nBytes);
+	bool IsEnabled();
+
+	// Forgets the history, for when the machine jumps somewhere else
+	void Clear();
+
+	// Called after every frame, taking a snapshot every REWIND_INTERVAL
+	void Capture(Machine& machine);
+
+	// Puts the machine back to the previous snapshot and runs a frame from
+	// it to draw the screen. Returns false once there's no more history,
+	// holding on the oldest snapshot.
+	bool StepBack(Machine& machine);
+
+	// Seconds of history, and how much of the ring it takes
+	double GetSeconds();
+	size_t GetBytesUsed();
+
+private:
+
+	struct Entry
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	void Store(const uint8_t* data, size_t size);
+
+	static size_t Compress(const uint8_t* input, size_t size, uint8_t* output);
+	static void Decompress(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize);
+	static size_t GetMaxCompressedSize(size_t size);
+
+	// Compressed differences, oldest first, in a ring of bytes
+	std::unique_ptr<uint8_t[]> m_Buffer;
+	size_t m_nSize = 0;
+	std::deque<Entry> m_Entries;
+	size_t m_nHead = 0;
+	size_t m_nBytesUsed = 0;
+
+	std::unique_ptr<MachineState> m_Latest;
+	std::unique_ptr<MachineState> m_Current;
+	std::vector<uint8_t> m_Compressed;
+	bool m_bHasLatest = false;
+	unsigned int m_nFramesSinceCapture = 0;
+};
@@ -0,0 +1,195 @@
+#include "SharedFrames.h"
+
+#include <iostream>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The other process only sees the memory, so nothing can be hidden behind a lock
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs lock-free atomics");
+
+static std::string GetSharedName(const std::string& sName)
+{
+	return (!sName.empty() && sName[0] == '/') ? sName : "/" + sName;
+}
+
+SharedFrames::~SharedFrames()
+{
+	Close();
+}
+
+bool SharedFrames::Open(const std::string& sName, unsigned int nSlots)
+{
+	Close();
+	if (nSlots == 0) nSlots = 1;
+
+#ifdef _WIN32
+	std::cerr << "Error: shared memory frames need POSIX shared memory" << std::endl;
+	return false;
+#else
+	const std::string sShared = GetSharedName(sName);
+	const size_t nSize = sizeof(SharedFramesHeader) + nSlots * sizeof(SharedFrameSlot);
+
+	// Starting afresh means readers never see a stale ring's frames
+	shm_unlink(sShared.c_str());
+	const int file = shm_open(sShared.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	void* mapping = MAP_FAILED;
+	if (file != -1 && ftruncate(file, nSize) == 0) mapping = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (file != -1) close(file);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "Error: unable to create shared memory " << sShared << std::endl;
+		if (file != -1) shm_unlink(sShared.c_str());
+		return false;
+	}
+
+	// The memory starts zeroed, so readers treat it as not ready until the magic is set
+	m_sName = sShared;
+	m_nSize = nSize;
+	m_Header = (SharedFramesHeader*)mapping;
+	m_Slots = (SharedFrameSlot*)(m_Header + 1);
+	m_Header->version = SHARED_FRAMES_VERSION;
+	m_Header->nSlots = nSlots;
+	m_Header->slotSize = sizeof(SharedFrameSlot);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_Header->magic = SHARED_FRAMES_MAGIC;
+
+	return true;
+#endif
+}
+
+void SharedFrames::Close()
+{
+#ifndef _WIN32
+	if (!m_Header) return;
+
+	// Readers still mapping it keep it until they're done
+	munmap(m_Header, m_nSize);
+	shm_unlink(m_sName.c_str());
+#endif
+	m_Header = nullptr;
+	m_Slots = nullptr;
+}
+
+bool SharedFrames::IsOpen()
+{
+	return m_Header != nullptr;
+}
+
+void SharedFrames::Publish(Machine& machine)
+{
+	if (!m_Header) return;
+
+	const uint64_t index = m_Header->published.load(std::memory_order_relaxed);
+	SharedFrameSlot& slot = m_Slots[index % m_Header->nSlots];
+
+	// Odd whilst writing
+	const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	GPU& gpu = machine.m_CPU.m_Memory.m_GPU;
+	slot.frame.index = index;
+	slot.frame.number = gpu.m_FrameCount;
+	slot.frame.cycles = machine.m_CPU.ticks;
+	slot.frame.hash = gpu.GetFrameHash();
+	slot.frame.input = machine.GetInput();
+	slot.frame.drawn = gpu.DidRenderLastFrame();
+	slot.frame.unchanged = gpu.IsFrameUnchanged();
+	memcpy(slot.frame.screen, machine.GetFramebuffer(), sizeof(slot.frame.screen));
+
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	m_Header->published.store(index + 1, std::memory_order_release);
+}
+
+SharedFramesReader::~SharedFramesReader()
+{
+	Close();
+}
+
+bool SharedFramesReader::Open(const std::string& sName)
+{
+	Close();
+
+#ifdef _WIN32
+	std::cerr << "Error: shared memory frames need POSIX shared memory" << std::endl;
+	return false;
+#else
+	const std::string sShared = GetSharedName(sName);
+	const int file = shm_open(sShared.c_str(), O_RDONLY, 0);
+	struct stat status;
+	void* mapping = MAP_FAILED;
+	if (file != -1 && fstat(file, &status) == 0 && (size_t)status.st_size >= sizeof(SharedFramesHeader))
+	{
+		mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+	}
+	if (file != -1) close(file);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "Error: unable to open shared memory " << sShared << std::endl;
+		return false;
+	}
+
+	m_nSize = status.st_size;
+	m_Header = (SharedFramesHeader*)mapping;
+	m_Slots = (SharedFrameSlot*)(m_Header + 1);
+
+	// Made by another build, or not set up yet
+	const bool bReady = m_Header->magic == SHARED_FRAMES_MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!bReady || m_Header->version != SHARED_FRAMES_VERSION || m_Header->slotSize != sizeof(SharedFrameSlot) ||
+		m_nSize < sizeof(SharedFramesHeader) + (size_t)m_Header->nSlots * sizeof(SharedFrameSlot) || m_Header->nSlots == 0)
+	{
+		std::cerr << "Error: shared memory " << sShared << " isn't a frame ring this build can read" << std::endl;
+		Close();
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+void SharedFramesReader::Close()
+{
+#ifndef _WIN32
+	if (m_Header) munmap(m_Header, m_nSize);
+#endif
+	m_Header = nullptr;
+	m_Slots = nullptr;
+}
+
+uint64_t SharedFramesReader::GetPublished()
+{
+	return m_Header ? m_Header->published.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFramesReader::Read(uint64_t index, SharedFrame& frame)
+{
+	if (index >= GetPublished()) return false;
+
+	const SharedFrameSlot& slot = m_Slots[index % m_Header->nSlots];
+	while (true)
+	{
+		const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		memcpy(&frame, &slot.frame, sizeof(SharedFrame));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == sequence) break;
+	}
+
+	// The writer may have gone round the ring since
+	return frame.index == index;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+#include "Machine.h"
+
+#define SHARED_FRAMES_MAGIC 0x46534250 // "PBSF"
+#define SHARED_FRAMES_VERSION 2
+#define SHARED_FRAMES_SLOTS 8
+
+// A finished frame, and the machine as it was when it finished
+struct SharedFrame
+{
+	uint64_t index; // how many frames were published before this one
+	uint64_t number; // V-Blanks since the machine was reset
+	uint64_t cycles; // CPU cycles since then
+	uint64_t hash; // see GPU::GetFrameHash
+	uint8_t input; // bit n is set if Key n is held
+	uint8_t drawn; // 0 if the frame was skipped, see GPU::DidRenderLastFrame
+	uint8_t unchanged; // 1 if the screen is the same as the frame before, see GPU::IsFrameUnchanged
+	uint8_t screen[144 * 160]; // a Colour for each pixel, see ConvertScreen
+};
+
+// Each slot is a seqlock: its sequence is odd whilst the frame is being
+// written, so a reader copies the frame then checks the sequence didn't change
+struct alignas(64) SharedFrameSlot
+{
+	std::atomic<uint64_t> sequence;
+	SharedFrame frame;
+};
+
+struct alignas(64) SharedFramesHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nSlots;
+	uint32_t slotSize;
+
+	// Frame n goes in slot n % nSlots
+	std::atomic<uint64_t> published;
+};
+
+/*
+	Publishes frames into a ring in POSIX shared memory (shm_open), so other
+	processes - recorders, analysers, trainers - can read them as they come
+	without a window or any copies through a pipe. The shared memory is a
+	SharedFramesHeader followed by its slots. The writer never waits for
+	readers; a reader that falls more than a ring behind misses frames.
+*/
+
+class SharedFrames
+{
+public:
+
+	~SharedFrames();
+
+	// Creates the shared memory (replacing any left behind). Names are
+	// like "/pixelboy", and a missing slash is added.
+	bool Open(const std::string& sName, unsigned int nSlots = SHARED_FRAMES_SLOTS);
+	void Close();
+	bool IsOpen();
+
+	// Called after each frame, from whichever thread is running the machine
+	void Publish(Machine& machine);
+
+private:
+
+	std::string m_sName;
+	SharedFramesHeader* m_Header = nullptr;
+	SharedFrameSlot* m_Slots = nullptr;
+	size_t m_nSize = 0;
+};
+
+// The other end, for programs reading the frames
+class SharedFramesReader
+{
+public:
+
+	~SharedFramesReader();
+
+	// Fails if nothing is publishing under that name
+	bool Open(const std::string& sName);
+	void Close();
+
+	// Frames published so far. The latest is GetPublished() - 1.
+	uint64_t GetPublished();
+
+	// Copies a frame out, returning false if it hasn't been published yet or
+	// has already been written over
+	bool Read(uint64_t index, SharedFrame& frame);
+
+private:
+
+	SharedFramesHeader* m_Header = nullptr;
+	SharedFrameSlot* m_Slots = nullptr;
+	size_t m_nSize = 0;
+};
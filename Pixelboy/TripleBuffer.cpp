@@ -0,0 +1,42 @@
+#include "TripleBuffer.h"
+
+#define FRESH_BIT 0b100
+#define INDEX_MASK 0b11
+
+TripleBuffer::TripleBuffer()
+{
+	m_Back = 0;
+	m_Middle = 1;
+	m_Front = 2;
+
+	for (Frame& frame : m_Frames)
+	{
+		for (uint8_t& pixel : frame.screen) pixel = 0; // white
+		frame.hash = 0;
+		frame.number = 0;
+	}
+}
+
+Frame& TripleBuffer::GetBack()
+{
+	return m_Frames[m_Back];
+}
+
+void TripleBuffer::Publish()
+{
+	// Release makes the frame's contents visible before its index
+	m_Back = m_Middle.exchange(m_Back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+bool TripleBuffer::Acquire()
+{
+	if (!(m_Middle.load(std::memory_order_relaxed) & FRESH_BIT)) return false;
+
+	m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & INDEX_MASK;
+	return true;
+}
+
+const Frame& TripleBuffer::GetFront()
+{
+	return m_Frames[m_Front];
+}
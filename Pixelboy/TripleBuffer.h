@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// A finished frame, as handed from the emulation thread to the screen
+struct Frame
+{
+	uint8_t screen[144 * 160]; // a Colour for each pixel
+	uint64_t hash;
+	unsigned long number;
+};
+
+/*
+	Lock-free handoff of frames from one writer thread to one reader thread.
+	The writer fills the back buffer then swaps it with the middle one; the
+	reader swaps the middle buffer with its front one whenever a newer frame
+	is there. Neither side ever waits, and the reader only sees whole frames.
+	https://www.remlab.net/op/vod.shtml
+*/
+
+class TripleBuffer
+{
+public:
+
+	TripleBuffer();
+
+	// Writer: the frame to fill in, then hand it over
+	Frame& GetBack();
+	void Publish();
+
+	// Reader: returns true if a newer frame has become the front one
+	bool Acquire();
+	const Frame& GetFront();
+
+private:
+
+	Frame m_Frames[3];
+
+	// Only touched by their own thread
+	int m_Back;
+	int m_Front;
+
+	// Index of the middle buffer, with FRESH_BIT set if it hasn't been read
+	std::atomic<int> m_Middle;
+};
@@ -0,0 +1,180 @@
+#include "WorkStealingPool.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+WorkStealingPool::WorkStealingPool(unsigned int nThreads)
+{
+	const std::vector<unsigned int> cores = GetCores();
+	if (nThreads == 0) nThreads = (unsigned int)cores.size();
+
+	for (unsigned int i = 0; i < nThreads; ++i) m_Queues.emplace_back(new Queue);
+	for (unsigned int i = 0; i < nThreads; ++i)
+	{
+		m_Threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+		PinToCore(m_Threads.back(), cores[i % cores.size()]);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bQuit = true;
+	}
+	m_WorkReady.notify_all();
+
+	for (std::thread& thread : m_Threads) thread.join();
+}
+
+void WorkStealingPool::Run(int nTasks, const std::function<void(int)>& task)
+{
+	if (nTasks <= 0) return;
+
+	// The task is set first, as a thread still looking from the last run
+	// may pick up one of the new tasks straight away
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Task = &task;
+		m_nTasks = nTasks;
+		m_nTasksDone = 0;
+	}
+
+	// Each thread gets a run of neighbouring tasks
+	const int nThreads = (int)m_Threads.size();
+	for (int thread = 0; thread < nThreads; ++thread)
+	{
+		std::lock_guard<std::mutex> lock(m_Queues[thread]->mutex);
+		for (int i = nTasks * thread / nThreads; i < nTasks * (thread + 1) / nThreads; ++i) m_Queues[thread]->tasks.push_back(i);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Generation++;
+	}
+	m_WorkReady.notify_all();
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_WorkDone.wait(lock, [this] { return m_nTasksDone == m_nTasks; });
+	m_Task = nullptr;
+}
+
+unsigned int WorkStealingPool::GetThreadCount()
+{
+	return (unsigned int)m_Threads.size();
+}
+
+void WorkStealingPool::WorkerLoop(unsigned int thread)
+{
+	unsigned long lastGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkReady.wait(lock, [&] { return m_bQuit || (m_Generation != lastGeneration && m_Task != nullptr); });
+			if (m_bQuit) return;
+			lastGeneration = m_Generation;
+		}
+
+		DoTasks(thread);
+	}
+}
+
+void WorkStealingPool::DoTasks(unsigned int thread)
+{
+	int task;
+	while (TakeTask(thread, task))
+	{
+		const std::function<void(int)>* function;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			function = m_Task;
+		}
+
+		(*function)(task);
+
+		bool bFinished;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			bFinished = ++m_nTasksDone == m_nTasks;
+		}
+		if (bFinished) m_WorkDone.notify_all();
+	}
+}
+
+bool WorkStealingPool::TakeTask(unsigned int thread, int& task)
+{
+	// Our own tasks first, in order
+	{
+		Queue& queue = *m_Queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Then the last task of whichever thread is next along with any left.
+	// Nothing is added once a run has started, so if every queue is empty
+	// there's nothing more to do.
+	const unsigned int nThreads = (unsigned int)m_Queues.size();
+	for (unsigned int i = 1; i < nThreads; ++i)
+	{
+		Queue& victim = *m_Queues[(thread + i) % nThreads];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<unsigned int> WorkStealingPool::GetCores()
+{
+	std::vector<unsigned int> cores;
+
+#if defined(__linux__)
+	// Only the cores we're allowed to run on
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (unsigned int core = 0; core < CPU_SETSIZE; ++core) if (CPU_ISSET(core, &set)) cores.push_back(core);
+	}
+#endif
+
+	if (cores.empty())
+	{
+		const unsigned int nCores = std::thread::hardware_concurrency();
+		for (unsigned int core = 0; core < (nCores != 0 ? nCores : 1); ++core) cores.push_back(core);
+	}
+
+	return cores;
+}
+
+void WorkStealingPool::PinToCore(std::thread& thread, unsigned int core)
+{
+	// Best effort - if it fails, the thread just runs wherever it's put
+#if defined(_WIN32)
+	if (core < sizeof(DWORD_PTR) * 8) SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+	(void)thread;
+	(void)core;
+#endif
+}
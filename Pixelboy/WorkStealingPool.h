@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	A pool of persistent threads, one per core and pinned to it, for lots of
+	independent tasks which each take a while (like running a ROM for a few
+	thousand frames). Each thread starts with its own share of the tasks and
+	works through them in order; once it runs out it steals from the far end
+	of another thread's share, so a few slow tasks don't leave cores idle.
+	Unlike WorkerPool, the calling thread only waits.
+*/
+
+class WorkStealingPool
+{
+public:
+
+	// 0 threads means one per core
+	WorkStealingPool(unsigned int nThreads = 0);
+	~WorkStealingPool();
+
+	// Calls task(0) ... task(nTasks - 1) spread across the pool, returning
+	// once every task has finished
+	void Run(int nTasks, const std::function<void(int)>& task);
+
+	unsigned int GetThreadCount();
+
+private:
+
+	// Each thread's tasks. The owner takes from the front, thieves the back.
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<int> tasks;
+	};
+
+	void WorkerLoop(unsigned int thread);
+	void DoTasks(unsigned int thread);
+	bool TakeTask(unsigned int thread, int& task);
+
+	static std::vector<unsigned int> GetCores();
+	static void PinToCore(std::thread& thread, unsigned int core);
+
+	std::vector<std::thread> m_Threads;
+	std::vector<std::unique_ptr<Queue>> m_Queues;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkReady;
+	std::condition_variable m_WorkDone;
+
+	const std::function<void(int)>* m_Task = nullptr;
+	int m_nTasks = 0;
+	int m_nTasksDone = 0;
+	unsigned long m_Generation = 0;
+	bool m_bQuit = false;
+};
@@ -0,0 +1,86 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned int nThreads)
+{
+	// The calling thread does work too, so spawn one less
+	for (unsigned int i = 1; i < nThreads; ++i) m_Threads.emplace_back(&WorkerPool::WorkerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bQuit = true;
+	}
+	m_WorkReady.notify_all();
+
+	for (std::thread& thread : m_Threads) thread.join();
+}
+
+void WorkerPool::Run(int nTasks, const std::function<void(int)>& task)
+{
+	if (nTasks <= 0) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Task = &task;
+		m_nTasks = nTasks;
+		m_nNextTask = 0;
+		m_nTasksDone = 0;
+		m_Generation++;
+	}
+	m_WorkReady.notify_all();
+
+	DoTasks();
+
+	// Wait for the stragglers
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_WorkDone.wait(lock, [this] { return m_nTasksDone == m_nTasks; });
+	m_Task = nullptr;
+}
+
+unsigned int WorkerPool::GetThreadCount()
+{
+	return (unsigned int)m_Threads.size() + 1;
+}
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned long lastGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkReady.wait(lock, [&] { return m_bQuit || (m_Generation != lastGeneration && m_Task != nullptr); });
+			if (m_bQuit) return;
+			lastGeneration = m_Generation;
+		}
+
+		DoTasks();
+	}
+}
+
+void WorkerPool::DoTasks()
+{
+	while (true)
+	{
+		int task;
+		const std::function<void(int)>* function;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Task == nullptr || m_nNextTask >= m_nTasks) return;
+			task = m_nNextTask++;
+			function = m_Task;
+		}
+
+		(*function)(task);
+
+		bool bFinished;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			bFinished = ++m_nTasksDone == m_nTasks;
+		}
+		if (bFinished) m_WorkDone.notify_all();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	A small pool of persistent threads that run a parallel for loop.
+	The calling thread takes part in the work, and Run() only returns
+	once every task has finished.
+*/
+
+class WorkerPool
+{
+public:
+
+	WorkerPool(unsigned int nThreads);
+	~WorkerPool();
+
+	// Calls task(0) ... task(nTasks - 1) spread across the pool
+	void Run(int nTasks, const std::function<void(int)>& task);
+
+	unsigned int GetThreadCount();
+
+private:
+
+	void WorkerLoop();
+	void DoTasks();
+
+	std::vector<std::thread> m_Threads;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkReady;
+	std::condition_variable m_WorkDone;
+
+	const std::function<void(int)>* m_Task = nullptr;
+	int m_nTasks = 0;
+	int m_nNextTask = 0;
+	int m_nTasksDone = 0;
+	unsigned long m_Generation = 0;
+	bool m_bQuit = false;
+};
@@ -12,21 +12,85 @@
 #include <chrono>
 #include <bitset>
 #include <string>
-
-#include "CPU.h"
-#include "Cartridge.h"
+#include <memory>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "Machine.h"
+#include "FramePacer.h"
+#include "EmulationThread.h"
+#include "CommandLine.h"
+#include "Headless.h"
+#include "Batch.h"
+#include "Disassembler.h"
+#include "Rewind.h"
+#include "SharedFrames.h"
+
+// In turbo mode, how long to emulate for before presenting the latest frame
+#define TURBO_PRESENT_MICROSECONDS 16667
+
+// How often the window shows the newest frame, when emulation has its own thread
+#define PRESENT_FRAMES_PER_SECOND 60.0
+
+// How often a debugger panel may be redrawn, however fast its contents change
+#define DEBUG_REFRESH_HZ 20
 
 class GameboyWindow : public olc::PixelGameEngine
 {
 private:
 	
-	CPU m_CPU;
-	unsigned int m_nLastTicks;
+	Machine m_Machine;
+	CPU& m_CPU = m_Machine.m_CPU;
+
+	// Paces frames to the GameBoy's refresh rate rather than the monitor's
+	FramePacer m_Pacer = FramePacer(FRAMES_PER_SECOND);
+
+	// In release builds the machine runs on its own thread, and this one only
+	// sends it input and shows the newest frame. The debugger reads and steps
+	// the machine directly, so debug builds emulate on this thread instead.
+	EmulationThread m_Emulation { m_Machine };
+	FramePacer m_PresentPacer = FramePacer(PRESENT_FRAMES_PER_SECOND);
+	uint8_t m_Keys = 0;
+
+	// Performance overlay, toggled with F1. Presenting is timed here, and the
+	// rest by the machine's own profiler.
+	bool m_bShowHUD = false;
+	Profiler m_PresentProfiler;
+	uint64_t m_UpdateEnd = 0;
+
+	// Hash of the frame on screen, so identical frames aren't drawn again
+	uint64_t m_PresentedFrameHash;
+	bool m_bPresentedFrame;
+
+	// The screen lives on the GPU, and is updated with a single copy a frame
+	std::unique_ptr<olc::Sprite> m_Screen;
+	std::unique_ptr<olc::Decal> m_ScreenDecal;
+
+	// Turbo runs the emulator as fast as it can, presenting only the latest frame
+	bool m_bTurbo = false;
+
+	// Emulation speed, shown in the title bar as a multiple of real time
+	std::string m_sTitle;
+	unsigned long m_nSpeedStartFrame = 0;
+	float m_SpeedSeconds = 0.0f;
+
+	// Frames run so far, for --frames and --dump-frame. Only touched by
+	// whichever thread is emulating.
+	CommandLine m_Options;
+	unsigned long m_nFramesRun = 0;
+	bool m_bQuit = false;
+
+	std::string m_sStateFile;
+
+	// Holding backspace plays the history backwards
+	Rewind m_Rewind { 0 };
+
+	// Every frame goes out to other processes too, with --shm
+	SharedFrames m_SharedFrames;
 	
 #if _DEBUG	
-	bool bDidInstruction = false;
 	bool bGoSlow = false;
-	uint16_t m_CrashAddress;
 #endif
 
 	bool m_bDidSplashScreen;
@@ -35,8 +99,24 @@ private:
 
 public:
 
-	GameboyWindow()
+	GameboyWindow(const CommandLine& options)
 	{
+		m_Options = options;
+		SetTurbo(options.m_bTurbo);
+		m_Emulation.SetFrameCallback([this]() { return OnFrame(); });
+		m_Rewind.SetSize((size_t)options.m_nRewindMegabytes * 1024 * 1024);
+		m_Emulation.SetRewind(&m_Rewind);
+		if (!options.m_sSharedFrames.empty() && !m_SharedFrames.Open(options.m_sSharedFrames)) exit(-1);
+
+		// A ROM on the command line skips the dialog
+		if (!options.m_sRom.empty())
+		{
+			if (!m_Machine.Load(options.m_sRom)) exit(-1);
+			ConfigureGPU();
+			UseStateFile(options.m_sRom);
+			return;
+		}
+
 		char const * lFilterPatterns[2] = { "*.gb", "*.rom" };
 
 		// Use "tiny file dialogs" to get a ROM
@@ -49,22 +129,52 @@ public:
 			0					// Only allow one file
 		);
 
-		m_CPU.m_Memory.Reset(selection, false);
-		m_CPU.m_Memory.m_GPU.Reset(m_CPU.m_Memory.m_Vram, m_CPU.m_Memory.m_Oam);
-		m_CPU.Reset();
+		if (selection == NULL) exit(0);
+
+		if (!m_Machine.Load(selection))
+		{
+			// Make error box
+			tinyfd_messageBox("Error", std::string("Could not load file " + std::string(selection)).c_str(), "ok", "error", 1);
+			exit(-1);
+		}
+		ConfigureGPU();
+		UseStateFile(selection);
 	}
 
-	bool OnUserCreate() override
+	void ConfigureGPU()
 	{
-		m_nLastTicks = 0;
+		// Loading a ROM resets the GPU, so this comes after
+		m_CPU.m_Memory.m_GPU.SetAccurateTiming(m_Options.m_bAccurateTiming);
+		m_CPU.m_Memory.m_GPU.SetDeferredRendering(m_Options.m_nRenderThreads);
+		m_CPU.m_Memory.m_GPU.SetFrameSkip(m_Options.m_nFrameSkip);
+	}
 
-		// Init joypad
-		for (int i = 0; i < 8; ++i) m_CPU.KeyReleased(i);
+	void UseStateFile(const std::string& sRom)
+	{
+		// F5 saves and F8 loads, to --state if given or next to the ROM otherwise
+		m_sStateFile = m_Options.m_sState.empty() ? sRom + ".state" : m_Options.m_sState;
+		if (!m_Options.m_sState.empty() && !m_Machine.LoadState(m_sStateFile)) exit(-1);
+	}
 
+	bool OnUserCreate() override
+	{
 		// Set window title to be the name of the game
-		sAppName = "PixelGameBoy - " + m_CPU.m_Memory.m_Cartridge.GetTitle();
+		m_sTitle = "PixelGameBoy - " + m_CPU.m_Memory.m_Cartridge.GetTitle();
+		sAppName = m_sTitle;
+
+		// Automation doesn't want to wait for the splash screen
+		m_bDidSplashScreen = !m_Options.m_sRom.empty();
+		m_SplashScreenMilliseconds = 0.0f;
+		m_bPresentedFrame = false;
+
+		m_Screen.reset(new olc::Sprite(160, 144));
+		m_ScreenDecal.reset(new olc::Decal(m_Screen.get()));
+
+#if _DEBUG
+		CreateDebugMenu();
+#endif
 
-		m_bDidSplashScreen = false;
+		if (m_bDidSplashScreen) StartEmulation();
 
 		return true;
 	}
@@ -82,87 +192,183 @@ public:
 
 		// Keep track of time
 		m_SplashScreenMilliseconds += fElapsedTime;
-		if (m_SplashScreenMilliseconds >= SPLASH_SCREEN_SECONDS) m_bDidSplashScreen = true;
+		if (m_SplashScreenMilliseconds >= SPLASH_SCREEN_SECONDS)
+		{
+			m_bDidSplashScreen = true;
+			StartEmulation();
+		}
 
 		return true;
 	}
 
 #ifdef _DEBUG
-	void DrawDebugMenu()
+	// A part of the debugger, drawn into its own sprite only when what it
+	// shows has changed (and at most DEBUG_REFRESH_HZ), then put on screen
+	// each frame as a single decal
+	struct DebugPanel
+	{
+		olc::vf2d position;
+		std::function<uint64_t()> GetState;	// changes whenever the panel would
+		std::function<void()> Draw;			// draws into the panel's sprite
+
+		std::unique_ptr<olc::Sprite> sprite;
+		std::unique_ptr<olc::Decal> decal;
+		uint64_t state = 0;
+		bool bDrawn = false;
+		std::chrono::steady_clock::time_point lastDrawn;
+	};
+	std::vector<DebugPanel> m_DebugPanels;
+	Disassembler m_Disassembler;
+
+	static std::string HexToString(int hex)
+	{
+		char sHex[8];
+		snprintf(sHex, sizeof(sHex), "0x%X", hex);
+		return sHex;
+	}
+
+	static std::string BinaryToString(int binary)
+	{
+		return std::bitset<8>(binary).to_string();
+	}
+
+	// Mixes values into a state, so any change is noticed
+	static uint64_t Combine(std::initializer_list<uint64_t> values)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (uint64_t value : values) hash = (hash ^ value) * 1099511628211ull;
+		return hash;
+	}
+
+	void AddDebugPanel(const olc::vf2d& position, int nLines, const std::function<uint64_t()>& GetState, const std::function<void()>& Draw)
+	{
+		// Panels are drawn at full size, and shown at half
+		DebugPanel panel;
+		panel.position = position;
+		panel.GetState = GetState;
+		panel.Draw = Draw;
+		panel.sprite.reset(new olc::Sprite(270, nLines * 10));
+		panel.decal.reset(new olc::Decal(panel.sprite.get()));
+		m_DebugPanels.push_back(std::move(panel));
+	}
+
+	void CreateDebugMenu()
 	{
 		const float x = 165;
 		const float y = 5;
-		const olc::vf2d scale(0.5f, 0.5f);
 
-		auto hexToString = [](int hex) { return (static_cast<std::stringstream const&>(std::stringstream() << "0x" << std::hex << hex)).str(); };
-		auto binaryToString = [](int binary) { return std::bitset<8>(binary).to_string(); };
+		auto Line = [&](float x, int line, const std::string& sText, olc::Pixel colour) { DrawString(olc::vi2d((int)x * 2, line * 10), sText, colour); };
 
-		auto DrawRegisters = [&](const float x, const float y)
+		// Registers
+		AddDebugPanel(olc::vf2d(x, y), 6, [=]()
+		{
+			return Combine({ m_CPU.m_RegisterAF.reg, m_CPU.m_RegisterBC.reg, m_CPU.m_RegisterDE.reg, m_CPU.m_RegisterHL.reg, m_CPU.m_StackPointer, m_CPU.m_ProgramCounter });
+		}, [=]()
 		{
-			DrawStringDecal(olc::vf2d(x + 00, y + 0), "AF: " + hexToString(m_CPU.m_RegisterAF.reg), olc::YELLOW, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 5), "BC: " + hexToString(m_CPU.m_RegisterBC.reg), olc::YELLOW, scale);
-			DrawStringDecal(olc::vf2d(x + 50, y + 0), "DE: " + hexToString(m_CPU.m_RegisterDE.reg), olc::YELLOW, scale);
-			DrawStringDecal(olc::vf2d(x + 50, y + 5), "HL: " + hexToString(m_CPU.m_RegisterHL.reg), olc::YELLOW, scale);
+			Line(00, 0, "AF: " + HexToString(m_CPU.m_RegisterAF.reg), olc::YELLOW);
+			Line(00, 1, "BC: " + HexToString(m_CPU.m_RegisterBC.reg), olc::YELLOW);
+			Line(50, 0, "DE: " + HexToString(m_CPU.m_RegisterDE.reg), olc::YELLOW);
+			Line(50, 1, "HL: " + HexToString(m_CPU.m_RegisterHL.reg), olc::YELLOW);
 
-			DrawStringDecal(olc::vf2d(x + 00, y + 15), "Stack pointer:   " + hexToString(m_CPU.m_StackPointer), olc::YELLOW, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 20), "Program counter: " + hexToString(m_CPU.m_ProgramCounter), olc::YELLOW, scale);
+			Line(00, 3, "Stack pointer:   " + HexToString(m_CPU.m_StackPointer), olc::YELLOW);
+			Line(00, 4, "Program counter: " + HexToString(m_CPU.m_ProgramCounter), olc::YELLOW);
 
 			std::string flags = "Flags: ";
 			flags += m_CPU.GetFlag(ZERO) ? "1" : "0";		flags += m_CPU.GetFlag(SUBTRACT) ? "1" : "0";
 			flags += m_CPU.GetFlag(HALF_CARRY) ? "1" : "0"; flags += m_CPU.GetFlag(CARRY) ? "1" : "0";
-			DrawStringDecal(olc::vf2d(x + 00, y + 25), flags, olc::YELLOW, scale);
-		};
+			Line(00, 5, flags, olc::YELLOW);
+		});
 
-		auto DrawMemory = [&](const float x, const float y)
+		// Disassembly around the program counter, from the cached bank
+		AddDebugPanel(olc::vf2d(x, y + 35), 10, [=]()
 		{
-			int nInstructions = 0;
-			uint16_t nPC = m_CPU.m_ProgramCounter - 5;
-			while (nInstructions < 10)
-			{
-				DrawStringDecal(olc::vf2d(x + 00, y + nInstructions * 5), hexToString(nPC) + "  " + m_CPU.instructions[m_CPU.m_Memory.ReadByte(nPC)].sMnemonic, nInstructions == 5 ? olc::RED : olc::WHITE, scale);
-				nPC += m_CPU.instructions[m_CPU.m_Memory.ReadByte(nPC)].length + 1; // Skip to next instruction (length is important)
-				nInstructions++;
-			}
-		};
+			return Combine({ m_CPU.m_ProgramCounter, m_CPU.m_Memory.m_CurrentROMBank, m_CPU.m_Memory.m_bBootRom });
+		}, [=]()
+		{
+			const std::vector<DisassembledLine> lines = m_Disassembler.GetLines(m_CPU, m_CPU.m_ProgramCounter, 5, 4);
+			for (size_t i = 0; i < lines.size() && i < 10; ++i)
+				Line(00, (int)i, HexToString(lines[i].address) + "  " + lines[i].sText, lines[i].address == m_CPU.m_ProgramCounter ? olc::RED : olc::WHITE);
+		});
 
-		auto DrawLCD = [&](const float x, const float y)
+		// LCD
+		AddDebugPanel(olc::vf2d(x, y + 90), 4, [=]()
 		{
-			DrawStringDecal(olc::vf2d(x + 00, y + 00), "LCD control:  " + hexToString(m_CPU.m_Memory.m_GPU.m_Control), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 05), "LCD scanline: " + hexToString(m_CPU.m_Memory.m_GPU.m_Scanline), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 10), "LCD scrollX:  " + hexToString(m_CPU.m_Memory.m_GPU.m_ScrollX), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 15), "LCD scrollY:  " + hexToString(m_CPU.m_Memory.m_GPU.m_ScrollY), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 80, y + 10), "windowX:  " + hexToString(m_CPU.m_Memory.m_GPU.m_WindowX), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 80, y + 15), "windowY:  " + hexToString(m_CPU.m_Memory.m_GPU.m_WindowY), olc::GREEN, scale);
-		};
+			const GPU& gpu = m_CPU.m_Memory.m_GPU;
+			return Combine({ gpu.m_Control, gpu.m_Scanline, gpu.m_ScrollX, gpu.m_ScrollY, gpu.m_WindowX, gpu.m_WindowY });
+		}, [=]()
+		{
+			const GPU& gpu = m_CPU.m_Memory.m_GPU;
+			Line(00, 0, "LCD control:  " + HexToString(gpu.m_Control), olc::GREEN);
+			Line(00, 1, "LCD scanline: " + HexToString(gpu.m_Scanline), olc::GREEN);
+			Line(00, 2, "LCD scrollX:  " + HexToString(gpu.m_ScrollX), olc::GREEN);
+			Line(00, 3, "LCD scrollY:  " + HexToString(gpu.m_ScrollY), olc::GREEN);
+			Line(80, 2, "windowX:  " + HexToString(gpu.m_WindowX), olc::GREEN);
+			Line(80, 3, "windowY:  " + HexToString(gpu.m_WindowY), olc::GREEN);
+		});
+
+		// Interrupts
+		AddDebugPanel(olc::vf2d(x, y + 115), 3, [=]()
+		{
+			return Combine({ m_CPU.m_Memory.m_InterruptsEnabled, m_CPU.m_Memory.m_InterruptFlags, m_CPU.m_MasterInterupts });
+		}, [=]()
+		{
+			Line(00, 0, "Interrupts enabled:  " + BinaryToString(m_CPU.m_Memory.m_InterruptsEnabled), olc::GREEN);
+			Line(00, 1, "Interrupts flagged:  " + BinaryToString(m_CPU.m_Memory.m_InterruptFlags), olc::GREEN);
+			Line(00, 2, "Master interrupts :  " + std::string((m_CPU.m_MasterInterupts) ? "True" : "False"), olc::GREEN);
+		});
 
-		auto DrawInterrupts = [&](const float x, const float y)
+		// Banking
+		AddDebugPanel(olc::vf2d(x, y + 130), 2, [=]()
 		{
-			DrawStringDecal(olc::vf2d(x + 00, y + 00), "Interrupts enabled:  " + binaryToString(m_CPU.m_Memory.m_InterruptsEnabled), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 05), "Interrupts flagged:  " + binaryToString(m_CPU.m_Memory.m_InterruptFlags), olc::GREEN, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 10), "Master interrupts :  " + std::string((m_CPU.m_MasterInterupts) ? "True" : "False"), olc::GREEN, scale);
-		};
+			return Combine({ m_CPU.m_Memory.m_CurrentROMBank, m_CPU.m_Memory.m_CurrentRAMBank });
+		}, [=]()
+		{
+			Line(00, 0, "MCB1:  " + std::string((m_CPU.m_Memory.m_Cartridge.m_bMBC1) ? "True" : "False"), olc::BLUE);
+			Line(60, 0, "MCB2:  " + std::string((m_CPU.m_Memory.m_Cartridge.m_bMBC2) ? "True" : "False"), olc::BLUE);
+			Line(00, 1, "ROM bank:  " + std::to_string(m_CPU.m_Memory.m_CurrentROMBank), olc::BLUE);
+			Line(60, 1, "RAM bank:  " + std::to_string(m_CPU.m_Memory.m_CurrentRAMBank), olc::BLUE);
+		});
 
-		auto DrawBanking = [&](const float x, const float y)
+		// Input
+		AddDebugPanel(olc::vf2d(x, y + 142), 1, [=]()
 		{
-			DrawStringDecal(olc::vf2d(x + 00, y + 00), "MCB1:  " + std::string((m_CPU.m_Memory.m_Cartridge.m_bMBC1) ? "True" : "False"), olc::BLUE, scale);
-			DrawStringDecal(olc::vf2d(x + 60, y + 00), "MCB2:  " + std::string((m_CPU.m_Memory.m_Cartridge.m_bMBC2) ? "True" : "False"), olc::BLUE, scale);
-			DrawStringDecal(olc::vf2d(x + 00, y + 05), "ROM bank:  " + std::to_string(m_CPU.m_Memory.m_CurrentROMBank), olc::BLUE, scale);
-			DrawStringDecal(olc::vf2d(x + 60, y + 05), "RAM bank:  " + std::to_string(m_CPU.m_Memory.m_CurrentRAMBank), olc::BLUE, scale);
-		};
+			return Combine({ m_CPU.m_Memory.m_JoypadState });
+		}, [=]()
+		{
+			Line(00, 0, "Joypad state:  " + BinaryToString(m_CPU.m_Memory.m_JoypadState), olc::BLUE);
+		});
+	}
 
-		auto DrawInput = [&](const float x, const float y)
+	void DrawDebugMenu()
+	{
+		const olc::vf2d scale(0.5f, 0.5f);
+		const auto now = std::chrono::steady_clock::now();
+
+		for (DebugPanel& panel : m_DebugPanels)
 		{
-			DrawStringDecal(olc::vf2d(x + 00, y + 00), "Joypad state:  " + binaryToString(m_CPU.m_Memory.m_JoypadState), olc::BLUE, scale);
-		};
+			const uint64_t state = panel.GetState();
+			const bool bChanged = !panel.bDrawn || state != panel.state;
+			if (bChanged && now - panel.lastDrawn >= std::chrono::milliseconds(1000 / DEBUG_REFRESH_HZ))
+			{
+				SetDrawTarget(panel.sprite.get());
+				Clear(olc::BLANK);
+				panel.Draw();
+				SetDrawTarget(nullptr);
+				panel.decal->Update();
+
+				panel.state = state;
+				panel.bDrawn = true;
+				panel.lastDrawn = now;
+			}
 
-		DrawRegisters(x, y);
-		DrawMemory(x, y + 35);
-		DrawLCD(x, y + 90);
-		DrawInterrupts(x, y + 115);
-		//DrawBanking(x, y + 130);
-		DrawInput(x, y + 135);
+			DrawDecal(panel.position, panel.decal.get(), scale);
+		}
 
-		if (m_CPU.m_bCrashed) DrawStringDecal(olc::vf2d(10, 10), "CRASHED: " + hexToString(m_CrashAddress), olc::RED, scale);
+		if (m_CPU.m_bCrashed)
+		{
+			const Fault& fault = m_Machine.GetFault();
+			DrawStringDecal(olc::vf2d(10, 10), "CRASHED: " + std::string(GetFaultName(fault.reason)) + " at " + HexToString(fault.programCounter), olc::RED, scale);
+		}
 		if (m_CPU.m_bStopped) DrawStringDecal(olc::vf2d(10, 15), "STOPPED", olc::RED, scale);
 		if (m_CPU.m_bHalted) DrawStringDecal(olc::vf2d(10, 20), "HALTED", olc::RED, scale);
 	}
@@ -173,107 +379,239 @@ public:
 		// Draw splash screen, otherwise run emulator
 		if (!m_bDidSplashScreen) return DrawSplashScreen(fElapsedTime);
 
-		auto start = std::chrono::system_clock::now();
+		// The engine draws and swaps between updates, which counts as presenting
+		m_PresentProfiler.StartFrame();
+#ifdef PIXELBOY_PROFILE
+		if (m_UpdateEnd != 0) m_PresentProfiler.Add(PROFILE_PRESENT, Profiler::ReadTimestamp() - m_UpdateEnd);
+#endif
 
 		// Input
-		if (GetKey(olc::A).bPressed) m_CPU.KeyPressed(4);		if (GetKey(olc::A).bReleased) m_CPU.KeyReleased(4);	
-		if (GetKey(olc::S).bPressed) m_CPU.KeyPressed(5);		if (GetKey(olc::S).bReleased) m_CPU.KeyReleased(5);
-		if (GetKey(olc::ENTER).bPressed) m_CPU.KeyPressed(7);	if (GetKey(olc::RETURN).bReleased) m_CPU.KeyReleased(7);		
-		if (GetKey(olc::SPACE).bPressed) m_CPU.KeyPressed(6);	if (GetKey(olc::SPACE).bReleased) m_CPU.KeyReleased(6);
-		if (GetKey(olc::RIGHT).bPressed) m_CPU.KeyPressed(0);	if (GetKey(olc::RIGHT).bReleased) m_CPU.KeyReleased(0);
-		if (GetKey(olc::LEFT).bPressed) m_CPU.KeyPressed(1);	if (GetKey(olc::LEFT).bReleased) m_CPU.KeyReleased(1);
-		if (GetKey(olc::UP).bPressed) m_CPU.KeyPressed(2);		if (GetKey(olc::UP).bReleased) m_CPU.KeyReleased(2);
-		if (GetKey(olc::DOWN).bPressed) m_CPU.KeyPressed(3);	if (GetKey(olc::DOWN).bReleased) m_CPU.KeyReleased(3);
-
-		// Work out amount of clock cycles to do, which is MAX_CLOCKS_PER_SECOND
-		// divided by the current FPS
-		int nFPS = (int)(1.0f / fElapsedTime);
-		const int desiredClockCyles = MAX_CLOCKS_PER_SECOND / nFPS;
+		uint8_t keys = 0;
+		if (GetKey(olc::RIGHT).bHeld) keys |= 1 << KEY_RIGHT;
+		if (GetKey(olc::LEFT).bHeld) keys |= 1 << KEY_LEFT;
+		if (GetKey(olc::UP).bHeld) keys |= 1 << KEY_UP;
+		if (GetKey(olc::DOWN).bHeld) keys |= 1 << KEY_DOWN;
+		if (GetKey(olc::A).bHeld) keys |= 1 << KEY_A;
+		if (GetKey(olc::S).bHeld) keys |= 1 << KEY_B;
+		if (GetKey(olc::SPACE).bHeld) keys |= 1 << KEY_SELECT;
+		if (GetKey(olc::ENTER).bHeld) keys |= 1 << KEY_START;
+
+		// Tab toggles turbo
+		if (GetKey(olc::TAB).bPressed) SetTurbo(!m_bTurbo);
+		if (GetKey(olc::F1).bPressed) m_bShowHUD = !m_bShowHUD;
+
+		// The emulation thread mustn't be running whilst the state is touched
+		if (GetKey(olc::F5).bPressed || GetKey(olc::F8).bPressed)
+		{
+			m_Emulation.Stop();
+			if (GetKey(olc::F5).bPressed) m_Machine.SaveState(m_sStateFile);
+			else if (m_Machine.LoadState(m_sStateFile)) m_Rewind.Clear();
+#if !_DEBUG
+			m_Emulation.Start();
+#endif
+		}
 
 #if _DEBUG
-		// If shift pressed, go line by line
-		bDidInstruction = false;
-		if (GetKey(olc::SHIFT).bPressed) bGoSlow = !bGoSlow;
-#endif
+		m_Machine.SetInput(keys);
 
-		int cyclesThisUpdate = 0;
-		while (cyclesThisUpdate < desiredClockCyles && !m_CPU.m_bCrashed)
+		// Emulate one frame per update, or as many as possible in turbo.
+		// If shift pressed, go line by line, stepping with space
+		if (GetKey(olc::SHIFT).bPressed) bGoSlow = !bGoSlow;
+		if (bGoSlow)
 		{
-#if _DEBUG
-			// If space and shift pressed, go line by line
-			if (GetKey(olc::SPACE).bPressed && !bDidInstruction) { bDidInstruction = true; }
-			else if (bGoSlow) break;
-#endif
+			if (GetKey(olc::SPACE).bPressed) m_Machine.Step();
+		}
+		else if (GetKey(olc::BACK).bHeld && m_Rewind.IsEnabled()) m_Rewind.StepBack(m_Machine);
+		else RunFrames();
+		UpdateSpeed(fElapsedTime, m_nFramesRun);
+		if (m_bQuit) return false;
+
+		// The frame hash only changes at V-Blank, but stepping draws lines
+		// part way through a frame, so the screen always goes up
+		if (bGoSlow) m_bPresentedFrame = false;
+		ShowFrame(m_Machine.GetFramebuffer(), m_CPU.m_Memory.m_GPU.GetFrameHash());
+		DrawDecal(olc::vf2d(1, 1), m_ScreenDecal.get());
+		if (m_bShowHUD) DrawHUD(olc::vf2d(2, 2));
 
-			// Update CPU
-			unsigned int ticks = m_CPU.Update();
-#if _DEBUG
-			if (m_CPU.m_bCrashed) { m_CrashAddress = ticks; break; }
+		// Draw debug info
+		DrawDebugMenu();
+
+		// Wait until the next frame is due
+		if (!m_bTurbo) m_Pacer.Wait();
 #else
-			if (m_CPU.m_bCrashed) { break; }
-#endif
-			cyclesThisUpdate += ticks - m_nLastTicks;
+		// Only changes are sent, to the start of the emulator's next frame. If
+		// the queue is full, the change is sent again next time round.
+		if (keys != m_Keys && m_Emulation.SendInput(keys)) m_Keys = keys;
+		m_Emulation.SetRewinding(GetKey(olc::BACK).bHeld);
 
-			// Update timers
-			m_CPU.UpdateTimers(ticks - m_nLastTicks);
+		UpdateSpeed(fElapsedTime, m_Emulation.GetFramesRun());
+		if (m_Emulation.IsFinished()) return false;
 
-			// Update GPU
-			if (!m_CPU.m_bStopped)
-			{
-				InterruptReturns interrupts = m_CPU.m_Memory.m_GPU.Update(ticks - m_nLastTicks); // Update GPU
-				if (interrupts.bVblank) m_CPU.RequestInterrupt(VBLANK_FLAG_BIT);
-				if (interrupts.bLCD) m_CPU.RequestInterrupt(LCD_FLAG_BIT);
-			}	
-
-			// Do interrupts and keep track of timing
-			m_CPU.CheckForInterrupts();
-			m_nLastTicks = ticks;
+		if (m_Emulation.AcquireFrame())
+		{
+			const Frame& frame = m_Emulation.GetFrame();
+			ShowFrame(frame.screen, frame.hash);
 		}
+		DrawDecal(olc::vf2d(0, 0), m_ScreenDecal.get());
+		if (m_bShowHUD) DrawHUD(olc::vf2d(1, 1));
 
-		// Render screen
-		Clear(olc::BLACK);
-		for (int x = 0; x < 160; ++x)
+		// Emulation keeps its own time, so this only limits how often we present
+		m_PresentPacer.Wait();
+#endif
+
+		m_PresentProfiler.EndFrame();
+		m_UpdateEnd = Profiler::ReadTimestamp();
+
+		return true;
+	}
+
+	void DrawHUD(const olc::vf2d& position)
+	{
+		const olc::vf2d scale(0.5f, 0.5f);
+		const ProfileStats stats = m_Machine.m_Profiler.GetStats();
+		const ProfileStats present = m_PresentProfiler.GetStats();
+
+		FillRectDecal(position, olc::vf2d(100, 42), olc::Pixel(0, 0, 0, 192));
+
+		auto DrawLine = [&](int line, const char* sFormat, double a, double b)
 		{
-			for (int y = 0; y < 144; ++y)
-			{
-				uint8_t* pixel = m_CPU.m_Memory.m_GPU.m_ScreenData[x][y];
-#if _DEBUG
-				Draw(x+1, y+1, olc::Pixel(pixel[0], pixel[1], pixel[2]));
+			char sLine[64];
+			snprintf(sLine, sizeof(sLine), sFormat, a, b);
+			DrawStringDecal(position + olc::vf2d(2, 2 + line * 5.0f), sLine, olc::GREEN, scale);
+		};
+
+#ifdef PIXELBOY_PROFILE
+		DrawLine(0, "CPU %5.2fms  GPU %5.2fms", stats.sectionMilliseconds[PROFILE_CPU], stats.sectionMilliseconds[PROFILE_GPU]);
+		DrawLine(1, "INT %5.2fms  PRE %5.2fms", stats.sectionMilliseconds[PROFILE_INTERRUPTS], present.sectionMilliseconds[PROFILE_PRESENT]);
 #else
-				Draw(x, y, olc::Pixel(pixel[0], pixel[1], pixel[2]));
+		DrawLine(0, "No PIXELBOY_PROFILE", 0, 0);
+		DrawLine(1, "UI  %5.2fms", present.frameMilliseconds50, 0);
 #endif
-			}
+		DrawLine(2, "p50 %5.2fms  p99 %5.2fms", stats.frameMilliseconds50, stats.frameMilliseconds99);
+		DrawLine(3, "%6.2f MIPS %6.2fx", stats.instructionsPerSecond / 1000000.0, stats.framesPerSecond / FRAMES_PER_SECOND);
+
+		// Frame time histogram, scaled so the tallest bar fills the height
+		unsigned int tallest = 1;
+		for (unsigned int count : stats.histogram) tallest = std::max(tallest, count);
+		for (int bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS; ++bucket)
+		{
+			const float height = 16.0f * stats.histogram[bucket] / tallest;
+			FillRectDecal(position + olc::vf2d(2 + bucket * 2.75f, 40 - height), olc::vf2d(2, height), olc::YELLOW);
 		}
+	}
 
-		// Draw debug info
-#if _DEBUG
-		DrawDebugMenu();
+	void StartEmulation()
+	{
+		Clear(olc::BLACK);
+		m_Pacer.Reset();
+		m_PresentPacer.Reset();
+#if !_DEBUG
+		m_Emulation.Start();
 #endif
+	}
 
-		return true;
+	void RunFrames()
+	{
+		if (!m_bTurbo)
+		{
+			RunFrame();
+			return;
+		}
+
+		// Keep going until it's time to present
+		auto start = std::chrono::steady_clock::now();
+		do
+		{
+			RunFrame();
+		} while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(TURBO_PRESENT_MICROSECONDS) && !m_CPU.m_bCrashed && !m_bQuit);
+	}
+
+	void RunFrame()
+	{
+		m_Machine.RunFrame();
+		m_Rewind.Capture(m_Machine);
+		if (!OnFrame()) m_bQuit = true;
+	}
+
+	// Called after every frame by whichever thread is emulating. Returns false
+	// once --frames have been run.
+	bool OnFrame()
+	{
+		m_nFramesRun++;
+
+		if (m_nFramesRun == m_Options.m_nDumpFrame) SaveFrame(m_Options.m_sDumpFile, m_Machine.GetFramebuffer());
+		m_SharedFrames.Publish(m_Machine);
+		return m_nFramesRun != m_Options.m_nFrames;
+	}
+
+	void UpdateSpeed(float fElapsedTime, unsigned long nFramesRun)
+	{
+		// Once a second, like the engine's FPS counter
+		m_SpeedSeconds += fElapsedTime;
+		if (m_SpeedSeconds < 1.0f) return;
+
+		char sSpeed[32];
+		snprintf(sSpeed, sizeof(sSpeed), "%.2fx", (nFramesRun - m_nSpeedStartFrame) / m_SpeedSeconds / FRAMES_PER_SECOND);
+		sAppName = m_sTitle + " - " + sSpeed + (m_bTurbo ? " (turbo)" : "");
+
+		m_nSpeedStartFrame = nFramesRun;
+		m_SpeedSeconds = 0.0f;
+	}
+
+	void SetTurbo(bool bTurbo)
+	{
+		m_bTurbo = bTurbo;
+		m_Emulation.SetTurbo(bTurbo);
+
+		// Don't try to catch up on the time spent in turbo
+		if (!m_bTurbo) m_Pacer.Reset();
+	}
+
+	void ShowFrame(const uint8_t* screen, uint64_t hash)
+	{
+		PROFILE_SCOPE(m_PresentProfiler, PROFILE_PRESENT, true);
+
+		// Upload the screen, unless it's the same as last time
+		if (!m_bPresentedFrame || hash != m_PresentedFrameHash)
+		{
+			// olc::Pixels are laid out as RGBA too
+			ConvertScreen(screen, reinterpret_cast<uint32_t*>(m_Screen->GetData()));
+			m_ScreenDecal->Update();
+		}
+
+		m_PresentedFrameHash = hash;
+		m_bPresentedFrame = true;
 	}
 
 	bool OnUserDestroy() override
 	{
+		m_Emulation.Stop();
 		return true;
 	}
 
 };
 
 
-int main()
+int main(int argc, char* argv[])
 {
+	CommandLine options;
+	if (!options.Parse(argc, argv)) return 1;
+
+	// These never open a window
+	if (!options.m_sBatch.empty()) return RunBatch(options);
+	if (options.m_bBench) return RunBenchmark(options);
+	if (options.m_bHeadless) return RunHeadless(options);
 
-	GameboyWindow window;
+	GameboyWindow window(options);
 
-	// Vsync in release mode
+	// Frames are paced by the emulator rather than V-Sync
 #if _DEBUG
-	if (window.Construct(300, 146, 4, 4, false, false))
+	if (window.Construct(300, 156, 4, 4, false, false))
 		window.Start();
 #else
-	if (window.Construct(160, 144, 4, 4, false, true))
+	if (window.Construct(160, 144, 4, 4, false, false))
 		window.Start();
 #endif
 
 	return 0;
-}
\ No newline at end of file
+}
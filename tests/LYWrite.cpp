@@ -0,0 +1,72 @@
+/*
+	A ROM which keeps writing LY, which sends it back to 0 mid-frame, so the
+	GPU sees far more than 144 lines between V-Blanks (if it ever gets one).
+	Deferred rendering used to capture every one of them and overflow.
+
+	Runs the ROM with lines drawn inline and deferred, and checks both get
+	through and show the same screen. Returns 0 if so.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+
+#include "../Pixelboy/Machine.h"
+
+#define TEST_FRAMES 10
+
+// Screen hash after TEST_FRAMES frames, or 0 if the machine couldn't run
+uint64_t Run(const std::string& sRom, unsigned int nRenderThreads)
+{
+	Machine machine;
+	if (!machine.Load(sRom)) return 0;
+
+	machine.m_CPU.m_Memory.m_GPU.SetDeferredRendering(nRenderThreads);
+	for (int frame = 0; frame < TEST_FRAMES; ++frame) machine.RunFrame();
+
+	if (machine.GetFault().reason != FAULT_NONE)
+	{
+		std::cerr << "Error: faulted with " << nRenderThreads << " render threads" << std::endl;
+		return 0;
+	}
+
+	return machine.GetScreenHash();
+}
+
+int main()
+{
+	std::vector<uint8_t> rom(0x8000, 0);
+
+	// Entry point: nop; jp $0150
+	const uint8_t entry[] = { 0x00, 0xC3, 0x50, 0x01 };
+	std::copy(entry, entry + sizeof(entry), rom.begin() + 0x100);
+
+	// ld a,$91; ldh ($40),a; loop: xor a; ldh ($44),a; jr loop
+	const uint8_t program[] = { 0x3E, 0x91, 0xE0, 0x40, 0xAF, 0xE0, 0x44, 0x18, 0xFB };
+	std::copy(program, program + sizeof(program), rom.begin() + 0x150);
+
+	const std::string sRom = "LYWrite.gb";
+	std::ofstream output(sRom, std::ios::binary);
+	output.write((const char*)rom.data(), rom.size());
+	output.close();
+	if (!output)
+	{
+		std::cerr << "Error: unable to write " << sRom << std::endl;
+		return 1;
+	}
+
+	const uint64_t inlineHash = Run(sRom, 0);
+	const uint64_t deferredHash = Run(sRom, 2);
+	std::remove(sRom.c_str());
+
+	if (inlineHash == 0 || deferredHash == 0) return 1;
+	if (inlineHash != deferredHash)
+	{
+		std::cerr << "Error: deferred rendering drew a different screen" << std::endl;
+		return 1;
+	}
+
+	std::cout << "LY writes: OK" << std::endl;
+	return 0;
+}